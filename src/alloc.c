@@ -0,0 +1,423 @@
+/*
+ * This file is part of cUTest.
+ *
+ * cUTest is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cUTest is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cUTest. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Martino Pilia, 2015
+ */
+
+/*!
+ * \file alloc.c
+ *
+ * @author Martino Pilia
+ * @date 2015-01-13
+ */
+
+#include <errno.h>
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "cutest.h"
+
+/*
+ * Entry points of the allocator of the GNU C library, which makes the 
+ * tracking depend on it. The allocation functions defined in this file
+ * interpose the ones of the C library, and forward each call to these,
+ * updating the counters only while tracking is active, or while the
+ * calling thread is inside an allocation free region. Blocks are not
+ * tagged, so the size of a freed block is read with malloc_usable_size(),
+ * and a block allocated before the start of the tracking and freed after
+ * it is counted as a release only.
+ */
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t n, size_t size);
+extern void* __libc_realloc(void *ptr, size_t size);
+extern void* __libc_memalign(size_t alignment, size_t size);
+extern void* __libc_valloc(size_t size);
+extern void* __libc_pvalloc(size_t size);
+extern void __libc_free(void *ptr);
+
+/*
+ * Counters of the allocations, updated atomically since test cases may
+ * allocate from several threads. The leaked counter holds the usable
+ * bytes of the blocks allocated and not freed.
+ */
+static volatile int tracking = 0;
+static Alloc_stats counters;
+
+/*
+ * Blocks and bytes allocated by each thread, used by the assertions on the
+ * allocations of the test cases, and depth of the allocation free regions
+ * the thread is in.
+ */
+static __thread long thread_allocs = 0;
+static __thread long thread_bytes = 0;
+static __thread int thread_regions = 0;
+
+/*
+ * First allocation free region of the test case left before its check,
+ * with a NULL assertion if none.
+ */
+static __thread Alloc_region escaped;
+
+/*
+ * Add a counter, without ordering constraints.
+ */
+static void count(long *c, long n)
+{
+    __atomic_add_fetch(c, n, __ATOMIC_RELAXED);
+}
+
+/*
+ * Count the allocation of a block of the given requested size.
+ */
+static void count_alloc(void *p, size_t size)
+{
+    if (p == NULL || !(tracking || thread_regions))
+        return;
+
+    thread_allocs++;
+    thread_bytes += size;
+    if (!tracking)
+        return;
+
+    count(&counters.allocs, 1);
+    count(&counters.bytes, (long) size);
+    count(&counters.leaked, (long) malloc_usable_size(p));
+}
+
+/*
+ * Count the release of a block of the given usable size.
+ */
+static void count_free(size_t usable)
+{
+    count(&counters.frees, 1);
+    count(&counters.leaked, -(long) usable);
+}
+
+/*!
+ * Allocate a block, counting it.
+ */
+void* malloc(size_t size)
+{
+    void *p = __libc_malloc(size);
+
+    count_alloc(p, size);
+    return p;
+}
+
+/*!
+ * Allocate a zeroed array, counting it.
+ */
+void* calloc(size_t n, size_t size)
+{
+    void *p = __libc_calloc(n, size);
+
+    count_alloc(p, n * size);
+    return p;
+}
+
+/*!
+ * Resize a block. A successful resize is counted as the release of the 
+ * old block and the allocation of a new one, and a resize to zero bytes
+ * as a release.
+ */
+void* realloc(void *ptr, size_t size)
+{
+    size_t usable = 0;
+    void *p;
+
+    if (tracking && ptr != NULL)
+        usable = malloc_usable_size(ptr);
+
+    p = __libc_realloc(ptr, size);
+    if (p == NULL && size > 0) /* failed, the old block is still valid */
+        return p;
+
+    if (tracking && ptr != NULL)
+        count_free(usable);
+    count_alloc(p, size);
+    return p;
+}
+
+/*!
+ * Allocate a block with the given alignment, counting it.
+ */
+void* memalign(size_t alignment, size_t size)
+{
+    void *p = __libc_memalign(alignment, size);
+
+    count_alloc(p, size);
+    return p;
+}
+
+/*!
+ * Allocate a block with the given alignment, counting it.
+ */
+void* aligned_alloc(size_t alignment, size_t size)
+{
+    void *p = __libc_memalign(alignment, size);
+
+    count_alloc(p, size);
+    return p;
+}
+
+/*!
+ * Allocate a block with the given alignment, which must be a power of two
+ * multiple of sizeof (void*), counting it.
+ */
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    void *p;
+
+    if (alignment == 0 || alignment % sizeof (void*) != 0
+            || (alignment & (alignment - 1)) != 0)
+        return EINVAL;
+
+    p = __libc_memalign(alignment, size);
+    if (p == NULL)
+        return ENOMEM;
+
+    count_alloc(p, size);
+    *memptr = p;
+    return 0;
+}
+
+/*!
+ * Allocate a page aligned block, counting it.
+ */
+void* valloc(size_t size)
+{
+    void *p = __libc_valloc(size);
+
+    count_alloc(p, size);
+    return p;
+}
+
+/*!
+ * Allocate a page aligned block, rounded up to a whole number of pages,
+ * counting it.
+ */
+void* pvalloc(size_t size)
+{
+    void *p = __libc_pvalloc(size);
+
+    count_alloc(p, size);
+    return p;
+}
+
+/*!
+ * Resize a block to an array, failing if its size overflows, counting it
+ * as realloc() does.
+ */
+void* reallocarray(void *ptr, size_t n, size_t size)
+{
+    size_t bytes;
+
+    if (__builtin_mul_overflow(n, size, &bytes))
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    return realloc(ptr, bytes);
+}
+
+/*!
+ * Release a block, counting it while tracking is active.
+ */
+void free(void *ptr)
+{
+    if (tracking && ptr != NULL)
+        count_free(malloc_usable_size(ptr));
+    __libc_free(ptr);
+}
+
+/*!
+ * Reset the counters and start tracking the allocations of the process.
+ */
+void __alloc_start(void)
+{
+    counters.allocs = 0;
+    counters.frees = 0;
+    counters.bytes = 0;
+    counters.leaked = 0;
+    tracking = 1;
+}
+
+/*!
+ * Stop tracking the allocations, and return the counters collected since
+ * the last start. The releases of blocks allocated before the start are
+ * counted too, so blocks and leaked bytes are negative when a test case
+ * frees more memory than it allocates.
+ */
+void __alloc_stop(Alloc_stats *st)
+{
+    tracking = 0;
+
+    *st = counters;
+    st->blocks = st->allocs - st->frees;
+}
+
+/*!
+ * Reset the allocation counters of the calling thread, at the start of a
+ * test case. A region left by a failed assertion of a previous test case
+ * of the same worker is closed.
+ */
+void __alloc_thread_reset(void)
+{
+    thread_allocs = 0;
+    thread_bytes = 0;
+    thread_regions = 0;
+    escaped.assertion = NULL;
+}
+
+/*!
+ * Enter an allocation free region, counting the allocations of the 
+ * calling thread until the end of the region, and return the counters of
+ * the thread so far.
+ */
+Alloc_region __alloc_region_start(const char *assertion, const char *file,
+        int line, Status *__s)
+{
+    Alloc_region r = {thread_allocs, thread_bytes, 0, 0, assertion, file,
+        line, __s};
+
+    thread_regions++;
+    return r;
+}
+
+/*
+ * Leave an allocation free region.
+ */
+static void region_leave(Alloc_region *r)
+{
+    r->checked = 1;
+    if (thread_regions > 0)
+        thread_regions--;
+}
+
+/*!
+ * Close a region which was left by its statement with break, return or 
+ * goto, before the check of the allocations. The region is recorded, to
+ * mark the assertion as invalid at the end of the test case, unless an
+ * assertion inside the region already failed.
+ */
+void __alloc_region_end(Alloc_region *r)
+{
+    if (r->checked)
+        return;
+
+    region_leave(r);
+    if (!r->s->failed && escaped.assertion == NULL)
+        escaped = *r;
+}
+
+/*!
+ * Mark the status of a test case as invalid if an allocation free region
+ * was left before its check, and no assertion failed.
+ */
+void __alloc_regions_check(Status *__s)
+{
+    if (escaped.assertion == NULL || __s->failed)
+        return;
+
+    __s->assertion = escaped.assertion;
+    __s->file = escaped.file;
+    __s->line = escaped.line;
+    snprintf(__s->message, MSG_LEN,
+            "The region was left with break, return or goto, before the "
+            "check of its allocations.");
+    __s->failed = 1;
+    __s->invalid = 1;
+}
+
+/*!
+ * This function actually implements the check of a region which must not
+ * allocate, comparing the counters of the thread with the ones saved at
+ * the start of the region.
+ */
+int __assert_no_alloc(Alloc_region *r, Status *__s)
+{
+    long allocs;
+    long bytes;
+
+    region_leave(r);
+
+    allocs = thread_allocs - r->allocs;
+    bytes = thread_bytes - r->bytes;
+
+    __s->failed = allocs > 0;
+    __s->invalid = 0;
+    if (__s->failed)
+        snprintf(__s->message, MSG_LEN,
+                "%ld allocations (%ld bytes) inside the region.",
+                allocs, bytes);
+
+    return 0;
+}
+
+/*!
+ * This function actually implements the check of the bytes allocated by
+ * the test case, which are counted only while tracking is active.
+ */
+int __assert_alloc_bytes_below(long n, Status *__s)
+{
+    if (!tracking)
+    {
+        snprintf(__s->message, MSG_LEN,
+                "Allocation tracking is not active (see --track-alloc).");
+        __s->failed = 1;
+        __s->invalid = 1;
+        return 0;
+    }
+
+    __s->failed = thread_bytes >= n;
+    __s->invalid = 0;
+    if (__s->failed)
+        snprintf(__s->message, MSG_LEN,
+                "%ld bytes allocated in %ld blocks, bound %ld bytes.",
+                thread_bytes, thread_allocs, n);
+
+    return 0;
+}
+
+/*!
+ * This function actually implements the check of the peak resident set
+ * size of the process, which is reset at the start of each test case. The
+ * assertion is invalid when the peak cannot be reset.
+ */
+int __assert_max_rss_below(long bytes, Status *__s)
+{
+    long rss = __peak_rss() * 1024;
+
+    if (rss == 0)
+    {
+        snprintf(__s->message, MSG_LEN,
+                "The peak resident set size of the test case is not "
+                "available (see /proc/self/clear_refs).");
+        __s->failed = 1;
+        __s->invalid = 1;
+        return 0;
+    }
+
+    __s->failed = rss >= bytes;
+    __s->invalid = 0;
+    if (__s->failed)
+        snprintf(__s->message, MSG_LEN,
+                "Peak resident set size %ld bytes, bound %ld bytes.",
+                rss, bytes);
+
+    return 0;
+}
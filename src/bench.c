@@ -0,0 +1,158 @@
+/*
+ * This file is part of cUTest.
+ *
+ * cUTest is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cUTest is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cUTest. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Martino Pilia, 2015
+ */
+
+/*!
+ * \file bench.c
+ * \brief Benchmarks of the containers used by cUTest, run by make bench.
+ *
+ * @author Martino Pilia
+ * @date 2015-01-13
+ */
+
+#include "cutest.h"
+
+/*
+ * Number of elements of the lists used in the benchmarks.
+ */
+#define BENCH_LIST_LEN 1000
+
+/*
+ * An element of an intrusive list.
+ */
+typedef struct item
+{
+    int value;
+    il_node node;
+} Item;
+
+static int values[BENCH_LIST_LEN];
+static Item items[BENCH_LIST_LEN];
+
+/*
+ * Fill a list with the elements of values.
+ */
+static void fill(ll_list *l)
+{
+    int i;
+
+    for (i = 0; i < BENCH_LIST_LEN; i++)
+        ll_push_front(l, &values[i]);
+}
+
+BENCHMARK(push_front_pop_front)
+{
+    ll_list l;
+    int i;
+
+    ll_init(&l);
+    BENCHMARK_LOOP
+    {
+        fill(&l);
+        for (i = 0; i < BENCH_LIST_LEN; i++)
+            do_not_optimize(ll_pop_front(&l));
+    }
+    ll_clear(&l);
+}
+
+BENCHMARK(push_back_pop_back)
+{
+    ll_list l;
+    int i;
+
+    ll_init(&l);
+    BENCHMARK_LOOP
+    {
+        for (i = 0; i < BENCH_LIST_LEN; i++)
+            ll_push_back(&l, &values[i]);
+        for (i = 0; i < BENCH_LIST_LEN; i++)
+            do_not_optimize(ll_pop_back(&l));
+    }
+    ll_clear(&l);
+}
+
+BENCHMARK(iterate)
+{
+    ll_list l;
+    ll_iterator it;
+    int sum;
+    int i;
+
+    ll_init(&l);
+    fill(&l);
+    BENCHMARK_LOOP
+    {
+        sum = 0;
+        it = ll_get_iterator(l);
+        for (i = 0; i < BENCH_LIST_LEN; i++)
+            sum += *(int*) ll_next(&it);
+        do_not_optimize(sum);
+    }
+    ll_clear(&l);
+}
+
+BENCHMARK(intrusive_push_front_pop_front)
+{
+    il_list l;
+    int i;
+
+    il_init(&l);
+    BENCHMARK_LOOP
+    {
+        for (i = 0; i < BENCH_LIST_LEN; i++)
+            il_push_front(&l, &items[i].node);
+        for (i = 0; i < BENCH_LIST_LEN; i++)
+            do_not_optimize(il_pop_front(&l));
+    }
+}
+
+BENCHMARK(intrusive_iterate)
+{
+    il_list l;
+    il_node *n;
+    int sum;
+    int i;
+
+    il_init(&l);
+    for (i = 0; i < BENCH_LIST_LEN; i++)
+        il_push_front(&l, &items[i].node);
+    BENCHMARK_LOOP
+    {
+        sum = 0;
+        il_for_each(n, &l)
+            sum += il_entry(n, Item, node)->value;
+        do_not_optimize(sum);
+    }
+}
+
+int main()
+{
+    Suite *s;
+
+    suite_new(&s, "Linked list", NULL, NULL);
+    suite_add_benchmark(s, push_front_pop_front, "push_front/pop_front 1000");
+    suite_add_benchmark(s, push_back_pop_back, "push_back/pop_back 1000");
+    suite_add_benchmark(s, iterate, "iterate 1000");
+    suite_add_benchmark(s, intrusive_push_front_pop_front,
+            "intrusive push_front/pop_front 1000");
+    suite_add_benchmark(s, intrusive_iterate, "intrusive iterate 1000");
+
+    suite_run(s);
+
+    return 0;
+}
@@ -0,0 +1,327 @@
+/*
+ * This file is part of cUTest.
+ *
+ * cUTest is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cUTest is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cUTest. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Martino Pilia, 2015
+ */
+
+/*!
+ * \file benchmark.c
+ *
+ * @author Martino Pilia
+ * @date 2015-01-13
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "cutest.h"
+
+/*
+ * Default duration of each benchmark sample, in milliseconds, and default
+ * number of samples.
+ */
+#define BENCH_TIME 50
+#define BENCH_SAMPLES 10
+
+/*
+ * Maximum factor for the growth of the iteration count between two
+ * calibration rounds.
+ */
+#define BENCH_MAX_GROWTH 100
+
+/*
+ * Current time from a monotonic clock, in nanoseconds.
+ */
+static long long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+ * Read a positive integer setting from the environment, or return the
+ * default value.
+ */
+static long get_setting(const char *name, long def)
+{
+    const char *env = getenv(name);
+
+    if (env != NULL && atol(env) > 0)
+        return atol(env);
+
+    return def;
+}
+
+/*!
+ * Start the timed loop of a benchmark, returning the number of iterations
+ * to be executed.
+ */
+size_t __bench_start(Bench *__b)
+{
+    __b->started = 1;
+    if (__b->perf != NULL)
+        __perf_start();
+    __b->start = now_ns();
+    return __b->iterations;
+}
+
+/*!
+ * Stop the timed loop of a benchmark. The return value is always zero, so
+ * that the call can terminate the loop condition.
+ */
+int __bench_stop(Bench *__b)
+{
+    __b->stop = now_ns();
+    if (__b->perf != NULL)
+        __perf_stop(__b->perf);
+    return 0;
+}
+
+/*
+ * Run a benchmark for the given number of iterations, and return the
+ * elapsed time in nanoseconds. When the benchmark does not contain a
+ * BENCHMARK_LOOP, the whole function is an iteration, and it is called
+ * repeatedly. The hardware counters, when read, cover the same code as
+ * the time: the BENCHMARK_LOOP, which restarts them, or all the calls.
+ */
+static double run_sample(void (*fun)(Bench*), Bench *b, size_t iters)
+{
+    long long t0;
+    double elapsed;
+    size_t i;
+
+    b->iterations = iters;
+    b->started = 0;
+
+    if (b->perf != NULL)
+        __perf_start();
+    t0 = now_ns();
+    fun(b);
+    if (b->started)
+        return (double) (b->stop - b->start);
+
+    for (i = 1; i < iters; i++)
+        fun(b);
+    elapsed = (double) (now_ns() - t0);
+    if (b->perf != NULL)
+        __perf_stop(b->perf);
+    return elapsed;
+}
+
+/*
+ * Find the number of iterations needed for a sample to last at least
+ * the target time, in nanoseconds.
+ */
+static size_t calibrate(void (*fun)(Bench*), Bench *b, double target)
+{
+    size_t iters = 1;
+    double elapsed;
+    double growth;
+
+    for (;;)
+    {
+        elapsed = run_sample(fun, b, iters);
+        if (elapsed >= target)
+            return iters;
+
+        growth = elapsed > 0.0 ? 1.2 * target / elapsed : BENCH_MAX_GROWTH;
+        if (growth > BENCH_MAX_GROWTH)
+            growth = BENCH_MAX_GROWTH;
+        if (growth < 2.0)
+            growth = 2.0;
+        iters = (size_t) (iters * growth);
+    }
+}
+
+/*
+ * Compare two doubles, for qsort().
+ */
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double*) a;
+    double y = *(const double*) b;
+
+    return (x > y) - (x < y);
+}
+
+/*
+ * Sort values, and return their median.
+ */
+static double sort_median(double *v, int n)
+{
+    qsort(v, n, sizeof (double), cmp_double);
+    return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+/*
+ * Compute the median and the minimum of the hardware counters per 
+ * iteration over the samples, for the counters read in all of them. The
+ * buffer v holds one value per sample.
+ */
+static void perf_stats(Bench_stats *bs, const Perf_counters *pc, double *v)
+{
+    int i;
+    int j;
+
+    bs->perf_mask = pc[0].mask;
+    for (j = 1; j < bs->samples; j++)
+        bs->perf_mask &= pc[j].mask;
+
+    for (i = 0; i < PERF_COUNTERS; i++)
+    {
+        if (!(bs->perf_mask & (1 << i)))
+            continue;
+
+        for (j = 0; j < bs->samples; j++)
+            v[j] = (double) pc[j].value[i] / bs->iterations;
+        bs->perf_median[i] = sort_median(v, bs->samples);
+        bs->perf_min[i] = v[0];
+    }
+}
+
+/*
+ * Execute a benchmark: calibrate the iteration count, run a warmup
+ * sample and then the measured samples, and compute the statistics of
+ * the time per iteration and, when enabled, of the hardware counters of
+ * each sample.
+ */
+static void run_benchmark(void (*fun)(Bench*), Bench_stats *bs)
+{
+    Bench b = {};
+    Perf_counters *pc = NULL;
+    double *t;
+    double sum = 0.0;
+    double var = 0.0;
+    int n = (int) get_setting("CUTEST_BENCH_SAMPLES", BENCH_SAMPLES);
+    int i;
+
+    t = (double*) malloc(n * sizeof (double));
+    if (__perf_enabled())
+        pc = (Perf_counters*) calloc(n, sizeof (Perf_counters));
+    if (t == NULL || (__perf_enabled() && pc == NULL))
+    {
+        perror("suite_run: malloc error.\n");
+        _exit(EXIT_FAILURE);
+    }
+
+    bs->iterations = calibrate(
+            fun,
+            &b,
+            get_setting("CUTEST_BENCH_TIME", BENCH_TIME) * 1e6);
+    run_sample(fun, &b, bs->iterations); /* warmup */
+
+    for (i = 0; i < n; i++)
+    {
+        b.perf = pc != NULL ? &pc[i] : NULL;
+        t[i] = run_sample(fun, &b, bs->iterations) / bs->iterations;
+        sum += t[i];
+    }
+
+    bs->samples = n;
+    bs->mean = sum / n;
+    for (i = 0; i < n; i++)
+        var += (t[i] - bs->mean) * (t[i] - bs->mean);
+    bs->stddev = n > 1 ? sqrt(var / (n - 1)) : 0.0;
+
+    bs->median = sort_median(t, n);
+    bs->min = t[0];
+
+    if (pc != NULL)
+        perf_stats(bs, pc, t);
+
+    free(pc);
+    free(t);
+}
+
+/*!
+ * Run the benchmarks of a suite sequentially, each one in a separate
+ * process, and report their statistics. Benchmarks never run in parallel,
+ * to avoid interferences between their measures.
+ */
+int __suite_run_benchmarks(struct suite *s)
+{
+    Benchmark *bm;
+    Bench_stats bs;
+    ll_iterator it = ll_get_iterator(s->benchmarks);
+    pid_t pid;
+    unsigned int i;
+    int fd[2];
+    int status;
+    ssize_t n;
+
+    for (i = 0; i < s->benchmarks.size; i++)
+    {
+        bm = (Benchmark*) ll_next(&it);
+
+        if (pipe(fd))
+        {
+            perror("suite_run: pipe error.\n");
+            exit(EXIT_FAILURE);
+        }
+
+        memset(&bs, 0, sizeof (Bench_stats));
+        fflush(NULL); /* do not duplicate pending output in the child */
+
+        pid = fork();
+        switch (pid)
+        {
+            case -1:
+                perror("suite_run: fork error.\n");
+                exit(EXIT_FAILURE);
+
+            case 0: /* child: run the benchmark and write its statistics */
+                close(fd[0]);
+                run_benchmark(bm->fun, &bs);
+                fflush(NULL); /* output of the benchmark only */
+                if (write(fd[1], &bs, sizeof (Bench_stats))
+                        != sizeof (Bench_stats))
+                {
+                    perror("suite_run: write error.\n");
+                    _exit(EXIT_FAILURE);
+                }
+                _exit(0);
+
+            default: /* parent: wait for the statistics */
+                close(fd[1]);
+                n = read(fd[0], &bs, sizeof (Bench_stats));
+                close(fd[0]);
+                while (waitpid(pid, &status, 0) == -1 && errno == EINTR)
+                    ;
+        }
+
+        if (WIFSIGNALED(status)) /* child process signaled */
+        {
+            bs.error = 1;
+            bs.term_sig = WTERMSIG(status);
+        }
+        else if (n != sizeof (Bench_stats)) /* child did not complete */
+        {
+            bs.error = 1;
+            bs.exit_status = WEXITSTATUS(status);
+        }
+
+        __report_bench(s, bm, &bs);
+    }
+
+    return 0;
+}
@@ -0,0 +1,302 @@
+/*
+ * This file is part of cUTest.
+ *
+ * cUTest is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cUTest is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cUTest. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Martino Pilia, 2015
+ */
+
+/*!
+ * \file cache.c
+ *
+ * @author Martino Pilia
+ * @date 2015-01-13
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "cutest.h"
+
+/*
+ * Default path of the cache file, relative to the working directory.
+ */
+#define CACHE_PATH ".cutest-cache"
+
+/*
+ * First line of the cache file, identifying its format.
+ */
+#define CACHE_HEADER "# cutest cache 2\n"
+
+/*
+ * Initial number of buckets of the cache table.
+ */
+#define CACHE_MIN_CAP 64
+
+/*
+ * Hash table of the cache entries, with open addressing and linear 
+ * probing. The capacity is a power of two.
+ */
+static Cache_entry *table = NULL;
+static size_t table_len = 0;
+static size_t table_cap = 0;
+static int loaded = 0;
+
+/*
+ * Path of the cache file, set with the CUTEST_CACHE environment variable.
+ * An empty value disables the cache.
+ */
+static const char* cache_path(void)
+{
+    const char *env = getenv("CUTEST_CACHE");
+
+    if (env == NULL)
+        return CACHE_PATH;
+
+    return *env != '\0' ? env : NULL;
+}
+
+/*
+ * FNV-1a hash of the suite and test case names.
+ */
+static size_t hash(const char *suite, const char *test)
+{
+    size_t h = 14695981039346656037ULL;
+
+    for (; *suite != '\0'; suite++)
+        h = (h ^ (unsigned char) *suite) * 1099511628211ULL;
+    h = (h ^ '\t') * 1099511628211ULL;
+    for (; *test != '\0'; test++)
+        h = (h ^ (unsigned char) *test) * 1099511628211ULL;
+
+    return h;
+}
+
+/*
+ * Find the bucket of an entry, or the empty bucket where it belongs.
+ */
+static Cache_entry* bucket(const char *suite, const char *test)
+{
+    size_t i = hash(suite, test) & (table_cap - 1);
+
+    while (table[i].suite != NULL && (strcmp(table[i].suite, suite)
+                || strcmp(table[i].test, test)))
+        i = (i + 1) & (table_cap - 1);
+
+    return &table[i];
+}
+
+/*
+ * Double the capacity of the table.
+ */
+static void grow(void)
+{
+    Cache_entry *old = table;
+    size_t old_cap = table_cap;
+    size_t i;
+
+    table_cap = table_cap > 0 ? 2 * table_cap : CACHE_MIN_CAP;
+    table = (Cache_entry*) calloc(table_cap, sizeof (Cache_entry));
+    if (table == NULL)
+    {
+        perror("cache: malloc error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (i = 0; i < old_cap; i++)
+        if (old[i].suite != NULL)
+            *bucket(old[i].suite, old[i].test) = old[i];
+
+    free(old);
+}
+
+/*
+ * Copy a string in newly allocated memory.
+ */
+static char* copy_string(const char *str)
+{
+    char *res = strdup(str);
+
+    if (res == NULL)
+    {
+        perror("cache: malloc error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return res;
+}
+
+/*
+ * Find the entry of a test case, creating it if not present.
+ */
+static Cache_entry* insert(const char *suite, const char *test)
+{
+    Cache_entry *e;
+
+    if (2 * (table_len + 1) > table_cap) /* keep load factor below 1/2 */
+        grow();
+
+    e = bucket(suite, test);
+    if (e->suite == NULL)
+    {
+        e->suite = copy_string(suite);
+        e->test = copy_string(test);
+        e->wall_us = -1;
+        table_len++;
+    }
+
+    return e;
+}
+
+/*
+ * Read the cache file. Each line contains the duration in microseconds,
+ * the failure flag, the suite name and the test case name, separated by
+ * tabs. A missing or unreadable file gives an empty cache.
+ */
+static void load(void)
+{
+    const char *path = cache_path();
+    Cache_entry *e;
+    FILE *f;
+    char *line = NULL;
+    char *suite;
+    char *test;
+    size_t len = 0;
+    ssize_t n;
+    long wall_us;
+    int failed;
+    int pos;
+
+    loaded = 1;
+
+    if (path == NULL || (f = fopen(path, "r")) == NULL)
+        return;
+
+    if ((n = getline(&line, &len, f)) == -1 || strcmp(line, CACHE_HEADER))
+    {
+        fclose(f); /* unknown format, discarded */
+        free(line);
+        return;
+    }
+
+    while ((n = getline(&line, &len, f)) != -1)
+    {
+        if (n > 0 && line[n - 1] == '\n')
+            line[n - 1] = '\0';
+
+        if (sscanf(line, "%ld\t%d\t%n", &wall_us, &failed, &pos) != 2)
+            continue;
+        suite = line + pos;
+        test = strchr(suite, '\t');
+        if (test == NULL)
+            continue;
+        *test++ = '\0';
+
+        e = insert(suite, test);
+        e->wall_us = wall_us;
+        e->failed = failed;
+    }
+
+    free(line);
+    fclose(f);
+}
+
+/*!
+ * Find the cache entry of a test case. When create is zero, return NULL
+ * if the test case is not in the cache. Names containing tabs or newlines
+ * cannot be stored, and always give NULL.
+ */
+Cache_entry* __cache_find(const char *suite, const char *test, int create)
+{
+    Cache_entry *e;
+
+    if (!loaded)
+        load();
+
+    if (strpbrk(suite, "\t\n") != NULL || strpbrk(test, "\t\n") != NULL)
+        return NULL;
+
+    if (create)
+        return insert(suite, test);
+
+    if (table_len == 0)
+        return NULL;
+
+    e = bucket(suite, test);
+    return e->suite != NULL ? e : NULL;
+}
+
+/*!
+ * Write the cache file. The file is replaced atomically, so concurrent
+ * runs never read a partial file.
+ */
+int __cache_save(void)
+{
+    const char *path = cache_path();
+    char tmp[FILENAME_MAX];
+    FILE *f;
+    size_t i;
+
+    if (path == NULL || !loaded)
+        return 0;
+
+    snprintf(tmp, sizeof (tmp), "%s.%d", path, (int) getpid());
+    if ((f = fopen(tmp, "w")) == NULL)
+        return 0; /* the cache is an optimization, failures are harmless */
+
+    fputs(CACHE_HEADER, f);
+    for (i = 0; i < table_cap; i++)
+        if (table[i].suite != NULL && table[i].wall_us >= 0)
+            fprintf(f, "%ld\t%d\t%s\t%s\n",
+                    table[i].wall_us,
+                    table[i].failed,
+                    table[i].suite,
+                    table[i].test);
+
+    if (fclose(f) || rename(tmp, path))
+        unlink(tmp);
+
+    return 0;
+}
+
+/*!
+ * Estimate the duration of the given test cases of a suite, in
+ * microseconds, from the cache. Test cases not in the cache are expected
+ * to last as the mean of the others, or 1 if none is known.
+ */
+int __cache_estimate(const char *suite, Test_case **tcs, int n, long *est)
+{
+    Cache_entry *e;
+    long sum = 0;
+    int known = 0;
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        e = __cache_find(suite, tcs[i]->name, 0);
+        est[i] = e != NULL ? e->wall_us : -1;
+        if (est[i] >= 0)
+        {
+            sum += est[i];
+            known++;
+        }
+    }
+
+    for (i = 0; i < n; i++)
+        if (est[i] < 0)
+            est[i] = known > 0 ? sum / known : 1;
+
+    return known;
+}
@@ -0,0 +1,1143 @@
+/*
+ * This file is part of cUTest.
+ *
+ * cUTest is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cUTest is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cUTest. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Martino Pilia, 2015
+ */
+
+/*!
+ * \file compare.c
+ *
+ * @author Martino Pilia
+ * @date 2015-01-13
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cutest.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define COMPARE_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * Number of bytes compared in each block. The kernels check for a mismatch
+ * only once per block, and scan the block again element by element to
+ * locate the first mismatch.
+ */
+#define BLOCK_BYTES 128
+
+/*
+ * Return the position of the first different entry of two int arrays, or
+ * len if they are equal.
+ */
+static size_t compare_int_scalar(const int *x, const int *y, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; ++i)
+        if (x[i] != y[i])
+            break;
+
+    return i;
+}
+
+/*
+ * Return the position of the first entries of two double arrays whose
+ * difference exceeds the tolerance, or len if there is none.
+ */
+static size_t compare_flo_scalar(
+        const double *x,
+        const double *y,
+        size_t len,
+        double tol)
+{
+    size_t i;
+
+    for (i = 0; i < len; ++i)
+        if (fabs(x[i] - y[i]) > tol)
+            break;
+
+    return i;
+}
+
+/*
+ * Return the position of the first entries of two double arrays which are
+ * not equal, or len if there is none. NaN is not equal to any value.
+ */
+static size_t equal_dbl_scalar(const double *x, const double *y, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; ++i)
+        if (!(x[i] == y[i]))
+            break;
+
+    return i;
+}
+
+/*
+ * Return the position of the first entries of two float arrays which are
+ * not equal, or len if there is none. NaN is not equal to any value.
+ */
+static size_t equal_flt_scalar(const float *x, const float *y, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; ++i)
+        if (!(x[i] == y[i]))
+            break;
+
+    return i;
+}
+
+/*
+ * Distance in units in the last place between two doubles, mapping their
+ * representation to integers with the same order. NaN is farther from
+ * every value than any number, and its distance, UINT64_MAX, is out of
+ * any tolerance.
+ */
+static uint64_t ulp_dbl(double x, double y)
+{
+    int64_t i, j;
+
+    if (isnan(x) || isnan(y))
+        return UINT64_MAX;
+
+    memcpy(&i, &x, sizeof (i));
+    memcpy(&j, &y, sizeof (j));
+    if (i < 0)
+        i = INT64_MIN - i;
+    if (j < 0)
+        j = INT64_MIN - j;
+
+    return i > j ? (uint64_t) i - (uint64_t) j : (uint64_t) j - (uint64_t) i;
+}
+
+/*
+ * Distance in units in the last place between two floats, UINT32_MAX
+ * when any of them is NaN.
+ */
+static uint32_t ulp_flt(float x, float y)
+{
+    int32_t i, j;
+
+    if (isnan(x) || isnan(y))
+        return UINT32_MAX;
+
+    memcpy(&i, &x, sizeof (i));
+    memcpy(&j, &y, sizeof (j));
+    if (i < 0)
+        i = INT32_MIN - i;
+    if (j < 0)
+        j = INT32_MIN - j;
+
+    return i > j ? (uint32_t) i - (uint32_t) j : (uint32_t) j - (uint32_t) i;
+}
+
+/*
+ * Check if two doubles are out of a tolerance in ulp. NaN is out of any
+ * tolerance, even when the tolerance covers its distance.
+ */
+static int ulp_dbl_out(double x, double y, uint64_t ulps)
+{
+    uint64_t d = ulp_dbl(x, y);
+
+    return d > ulps || d == UINT64_MAX;
+}
+
+/*
+ * Check if two floats are out of a tolerance in ulp.
+ */
+static int ulp_flt_out(float x, float y, uint64_t ulps)
+{
+    uint32_t d = ulp_flt(x, y);
+
+    return d > ulps || d == UINT32_MAX;
+}
+
+/*
+ * Check if two doubles are equal, or finite and with a difference within
+ * the absolute tolerance or the relative tolerance, scaled by the larger
+ * magnitude.
+ */
+static int close_dbl(double x, double y, double abs, double rel)
+{
+    double m = fmax(fabs(x), fabs(y));
+
+    if (x == y)
+        return 1;
+    if (!isfinite(x) || !isfinite(y))
+        return 0;
+
+    return fabs(x - y) <= fmax(abs, rel * m);
+}
+
+/*
+ * Check if two floats are equal, or finite and close, computing in single
+ * precision.
+ */
+static int close_flt(float x, float y, float abs, float rel)
+{
+    float m = fmaxf(fabsf(x), fabsf(y));
+
+    if (x == y)
+        return 1;
+    if (!isfinite(x) || !isfinite(y))
+        return 0;
+
+    return fabsf(x - y) <= fmaxf(abs, rel * m);
+}
+
+/*
+ * Error of two values out of tolerance, as ratio between their difference
+ * and the allowed difference.
+ */
+static double close_error(double x, double y, double abs, double rel)
+{
+    double allowed = fmax(abs, rel * fmax(fabs(x), fabs(y)));
+
+    if (!isfinite(x) || !isfinite(y) || !isfinite(x - y) || allowed <= 0.0)
+        return INFINITY;
+
+    return fabs(x - y) / allowed;
+}
+
+/*
+ * Scalar kernels for the tolerance comparisons, returning the position of
+ * the first entry out of tolerance, or len if there is none.
+ */
+static size_t ulp_dbl_scalar(
+        const double *x,
+        const double *y,
+        size_t len,
+        uint64_t ulps)
+{
+    size_t i;
+
+    for (i = 0; i < len; ++i)
+        if (ulp_dbl_out(x[i], y[i], ulps))
+            break;
+
+    return i;
+}
+
+static size_t ulp_flt_scalar(
+        const float *x,
+        const float *y,
+        size_t len,
+        uint64_t ulps)
+{
+    size_t i;
+
+    for (i = 0; i < len; ++i)
+        if (ulp_flt_out(x[i], y[i], ulps))
+            break;
+
+    return i;
+}
+
+static size_t close_dbl_scalar(
+        const double *x,
+        const double *y,
+        size_t len,
+        double abs,
+        double rel)
+{
+    size_t i;
+
+    for (i = 0; i < len; ++i)
+        if (!close_dbl(x[i], y[i], abs, rel))
+            break;
+
+    return i;
+}
+
+static size_t close_flt_scalar(
+        const float *x,
+        const float *y,
+        size_t len,
+        double abs,
+        double rel)
+{
+    size_t i;
+
+    for (i = 0; i < len; ++i)
+        if (!close_flt(x[i], y[i], (float) abs, (float) rel))
+            break;
+
+    return i;
+}
+
+/*
+ * Return the offset of the first different byte of two buffers, or len if
+ * they are equal.
+ */
+static size_t compare_bytes_scalar(
+        const unsigned char *x,
+        const unsigned char *y,
+        size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; ++i)
+        if (x[i] != y[i])
+            break;
+
+    return i;
+}
+
+#ifdef COMPARE_X86
+
+/*
+ * SSE2 kernel for byte buffers.
+ */
+__attribute__((target("sse2")))
+static size_t compare_bytes_sse2(
+        const unsigned char *x,
+        const unsigned char *y,
+        size_t len)
+{
+    const size_t step = BLOCK_BYTES;
+    __m128i d;
+    size_t i, j;
+
+    for (i = 0; i + step <= len; i += step)
+    {
+        d = _mm_setzero_si128();
+        for (j = i; j < i + step; j += 16)
+            d = _mm_or_si128(d, _mm_xor_si128(
+                    _mm_loadu_si128((const __m128i*) (x + j)),
+                    _mm_loadu_si128((const __m128i*) (y + j))));
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(d, _mm_setzero_si128()))
+                != 0xffff)
+            return i + compare_bytes_scalar(x + i, y + i, step);
+    }
+
+    return i + compare_bytes_scalar(x + i, y + i, len - i);
+}
+
+/*
+ * SSE2 kernel for int arrays.
+ */
+__attribute__((target("sse2")))
+static size_t compare_int_sse2(const int *x, const int *y, size_t len)
+{
+    const size_t step = BLOCK_BYTES / sizeof (int);
+    __m128i d;
+    size_t i, j;
+
+    for (i = 0; i + step <= len; i += step)
+    {
+        d = _mm_setzero_si128();
+        for (j = i; j < i + step; j += 4)
+            d = _mm_or_si128(d, _mm_xor_si128(
+                    _mm_loadu_si128((const __m128i*) (x + j)),
+                    _mm_loadu_si128((const __m128i*) (y + j))));
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(d, _mm_setzero_si128()))
+                != 0xffff)
+            return i + compare_int_scalar(x + i, y + i, step);
+    }
+
+    return i + compare_int_scalar(x + i, y + i, len - i);
+}
+
+/*
+ * SSE2 kernel for double arrays. The comparison is ordered, so entries
+ * whose difference is NaN match, as in the scalar kernel.
+ */
+__attribute__((target("sse2")))
+static size_t compare_flo_sse2(
+        const double *x,
+        const double *y,
+        size_t len,
+        double tol)
+{
+    const size_t step = BLOCK_BYTES / sizeof (double);
+    const __m128d sign = _mm_set1_pd(-0.0);
+    const __m128d t = _mm_set1_pd(tol);
+    __m128d d;
+    size_t i, j;
+
+    for (i = 0; i + step <= len; i += step)
+    {
+        d = _mm_setzero_pd();
+        for (j = i; j < i + step; j += 2)
+            d = _mm_or_pd(d, _mm_cmpgt_pd(
+                    _mm_andnot_pd(sign, _mm_sub_pd(
+                        _mm_loadu_pd(x + j),
+                        _mm_loadu_pd(y + j))),
+                    t));
+
+        if (_mm_movemask_pd(d))
+            return i + compare_flo_scalar(x + i, y + i, step, tol);
+    }
+
+    return i + compare_flo_scalar(x + i, y + i, len - i, tol);
+}
+
+/*
+ * SSE2 kernel for the equality of double arrays. The comparison is
+ * unordered, so NaN entries differ, as in the scalar kernel.
+ */
+__attribute__((target("sse2")))
+static size_t equal_dbl_sse2(const double *x, const double *y, size_t len)
+{
+    const size_t step = BLOCK_BYTES / sizeof (double);
+    __m128d d;
+    size_t i, j;
+
+    for (i = 0; i + step <= len; i += step)
+    {
+        d = _mm_setzero_pd();
+        for (j = i; j < i + step; j += 2)
+            d = _mm_or_pd(d, _mm_cmpneq_pd(
+                    _mm_loadu_pd(x + j),
+                    _mm_loadu_pd(y + j)));
+
+        if (_mm_movemask_pd(d))
+            return i + equal_dbl_scalar(x + i, y + i, step);
+    }
+
+    return i + equal_dbl_scalar(x + i, y + i, len - i);
+}
+
+/*
+ * SSE2 kernel for the equality of float arrays.
+ */
+__attribute__((target("sse2")))
+static size_t equal_flt_sse2(const float *x, const float *y, size_t len)
+{
+    const size_t step = BLOCK_BYTES / sizeof (float);
+    __m128 d;
+    size_t i, j;
+
+    for (i = 0; i + step <= len; i += step)
+    {
+        d = _mm_setzero_ps();
+        for (j = i; j < i + step; j += 4)
+            d = _mm_or_ps(d, _mm_cmpneq_ps(
+                    _mm_loadu_ps(x + j),
+                    _mm_loadu_ps(y + j)));
+
+        if (_mm_movemask_ps(d))
+            return i + equal_flt_scalar(x + i, y + i, step);
+    }
+
+    return i + equal_flt_scalar(x + i, y + i, len - i);
+}
+
+/*
+ * AVX2 kernel for byte buffers.
+ */
+__attribute__((target("avx2")))
+static size_t compare_bytes_avx2(
+        const unsigned char *x,
+        const unsigned char *y,
+        size_t len)
+{
+    const size_t step = BLOCK_BYTES;
+    __m256i d;
+    size_t i, j;
+
+    for (i = 0; i + step <= len; i += step)
+    {
+        d = _mm256_setzero_si256();
+        for (j = i; j < i + step; j += 32)
+            d = _mm256_or_si256(d, _mm256_xor_si256(
+                    _mm256_loadu_si256((const __m256i*) (x + j)),
+                    _mm256_loadu_si256((const __m256i*) (y + j))));
+
+        if (!_mm256_testz_si256(d, d))
+            return i + compare_bytes_scalar(x + i, y + i, step);
+    }
+
+    return i + compare_bytes_scalar(x + i, y + i, len - i);
+}
+
+/*
+ * AVX2 kernel for int arrays.
+ */
+__attribute__((target("avx2")))
+static size_t compare_int_avx2(const int *x, const int *y, size_t len)
+{
+    const size_t step = BLOCK_BYTES / sizeof (int);
+    __m256i d;
+    size_t i, j;
+
+    for (i = 0; i + step <= len; i += step)
+    {
+        d = _mm256_setzero_si256();
+        for (j = i; j < i + step; j += 8)
+            d = _mm256_or_si256(d, _mm256_xor_si256(
+                    _mm256_loadu_si256((const __m256i*) (x + j)),
+                    _mm256_loadu_si256((const __m256i*) (y + j))));
+
+        if (!_mm256_testz_si256(d, d))
+            return i + compare_int_scalar(x + i, y + i, step);
+    }
+
+    return i + compare_int_scalar(x + i, y + i, len - i);
+}
+
+/*
+ * AVX2 kernel for double arrays.
+ */
+__attribute__((target("avx2")))
+static size_t compare_flo_avx2(
+        const double *x,
+        const double *y,
+        size_t len,
+        double tol)
+{
+    const size_t step = BLOCK_BYTES / sizeof (double);
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    const __m256d t = _mm256_set1_pd(tol);
+    __m256d d;
+    size_t i, j;
+
+    for (i = 0; i + step <= len; i += step)
+    {
+        d = _mm256_setzero_pd();
+        for (j = i; j < i + step; j += 4)
+            d = _mm256_or_pd(d, _mm256_cmp_pd(
+                    _mm256_andnot_pd(sign, _mm256_sub_pd(
+                        _mm256_loadu_pd(x + j),
+                        _mm256_loadu_pd(y + j))),
+                    t,
+                    _CMP_GT_OQ));
+
+        if (_mm256_movemask_pd(d))
+            return i + compare_flo_scalar(x + i, y + i, step, tol);
+    }
+
+    return i + compare_flo_scalar(x + i, y + i, len - i, tol);
+}
+
+/*
+ * AVX2 kernel for the equality of double arrays.
+ */
+__attribute__((target("avx2")))
+static size_t equal_dbl_avx2(const double *x, const double *y, size_t len)
+{
+    const size_t step = BLOCK_BYTES / sizeof (double);
+    __m256d d;
+    size_t i, j;
+
+    for (i = 0; i + step <= len; i += step)
+    {
+        d = _mm256_setzero_pd();
+        for (j = i; j < i + step; j += 4)
+            d = _mm256_or_pd(d, _mm256_cmp_pd(
+                    _mm256_loadu_pd(x + j),
+                    _mm256_loadu_pd(y + j),
+                    _CMP_NEQ_UQ));
+
+        if (_mm256_movemask_pd(d))
+            return i + equal_dbl_scalar(x + i, y + i, step);
+    }
+
+    return i + equal_dbl_scalar(x + i, y + i, len - i);
+}
+
+/*
+ * AVX2 kernel for the equality of float arrays.
+ */
+__attribute__((target("avx2")))
+static size_t equal_flt_avx2(const float *x, const float *y, size_t len)
+{
+    const size_t step = BLOCK_BYTES / sizeof (float);
+    __m256 d;
+    size_t i, j;
+
+    for (i = 0; i + step <= len; i += step)
+    {
+        d = _mm256_setzero_ps();
+        for (j = i; j < i + step; j += 8)
+            d = _mm256_or_ps(d, _mm256_cmp_ps(
+                    _mm256_loadu_ps(x + j),
+                    _mm256_loadu_ps(y + j),
+                    _CMP_NEQ_UQ));
+
+        if (_mm256_movemask_ps(d))
+            return i + equal_flt_scalar(x + i, y + i, step);
+    }
+
+    return i + equal_flt_scalar(x + i, y + i, len - i);
+}
+
+/*
+ * Map the representation of four doubles to integers with the same order.
+ */
+__attribute__((target("avx2")))
+static inline __m256i ordered_dbl(__m256i v)
+{
+    const __m256i min = _mm256_set1_epi64x(INT64_MIN);
+
+    return _mm256_blendv_epi8(
+            v,
+            _mm256_sub_epi64(min, v),
+            _mm256_cmpgt_epi64(_mm256_setzero_si256(), v));
+}
+
+/*
+ * AVX2 kernel for the ULP comparison of double arrays. Distances are
+ * compared as unsigned integers, flipping their sign bit.
+ */
+__attribute__((target("avx2")))
+static size_t ulp_dbl_avx2(
+        const double *x,
+        const double *y,
+        size_t len,
+        uint64_t ulps)
+{
+    const size_t step = BLOCK_BYTES / sizeof (double);
+    const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+    const __m256i u = _mm256_set1_epi64x((int64_t) (ulps ^ (1ULL << 63)));
+    __m256i a, b, d, bad;
+    __m256d xv, yv;
+    size_t i, j;
+
+    for (i = 0; i + step <= len; i += step)
+    {
+        bad = _mm256_setzero_si256();
+        for (j = i; j < i + step; j += 4)
+        {
+            xv = _mm256_loadu_pd(x + j);
+            yv = _mm256_loadu_pd(y + j);
+            a = ordered_dbl(_mm256_castpd_si256(xv));
+            b = ordered_dbl(_mm256_castpd_si256(yv));
+            d = _mm256_blendv_epi8(
+                    _mm256_sub_epi64(b, a),
+                    _mm256_sub_epi64(a, b),
+                    _mm256_cmpgt_epi64(a, b));
+            bad = _mm256_or_si256(bad, _mm256_cmpgt_epi64(
+                    _mm256_xor_si256(d, sign), u));
+            bad = _mm256_or_si256(bad, _mm256_castpd_si256(
+                    _mm256_cmp_pd(xv, yv, _CMP_UNORD_Q)));
+        }
+
+        if (!_mm256_testz_si256(bad, bad))
+            return i + ulp_dbl_scalar(x + i, y + i, step, ulps);
+    }
+
+    return i + ulp_dbl_scalar(x + i, y + i, len - i, ulps);
+}
+
+/*
+ * Map the representation of eight floats to integers with the same order.
+ */
+__attribute__((target("avx2")))
+static inline __m256i ordered_flt(__m256i v)
+{
+    const __m256i min = _mm256_set1_epi32(INT32_MIN);
+
+    return _mm256_blendv_epi8(
+            v,
+            _mm256_sub_epi32(min, v),
+            _mm256_cmpgt_epi32(_mm256_setzero_si256(), v));
+}
+
+/*
+ * AVX2 kernel for the ULP comparison of float arrays.
+ */
+__attribute__((target("avx2")))
+static size_t ulp_flt_avx2(
+        const float *x,
+        const float *y,
+        size_t len,
+        uint64_t ulps)
+{
+    const size_t step = BLOCK_BYTES / sizeof (float);
+    const __m256i sign = _mm256_set1_epi32(INT32_MIN);
+    const __m256i u = _mm256_set1_epi32((int32_t) 
+            ((ulps > UINT32_MAX ? UINT32_MAX : (uint32_t) ulps) ^ (1U << 31)));
+    __m256i a, b, d, bad;
+    __m256 xv, yv;
+    size_t i, j;
+
+    for (i = 0; i + step <= len; i += step)
+    {
+        bad = _mm256_setzero_si256();
+        for (j = i; j < i + step; j += 8)
+        {
+            xv = _mm256_loadu_ps(x + j);
+            yv = _mm256_loadu_ps(y + j);
+            a = ordered_flt(_mm256_castps_si256(xv));
+            b = ordered_flt(_mm256_castps_si256(yv));
+            d = _mm256_blendv_epi8(
+                    _mm256_sub_epi32(b, a),
+                    _mm256_sub_epi32(a, b),
+                    _mm256_cmpgt_epi32(a, b));
+            bad = _mm256_or_si256(bad, _mm256_cmpgt_epi32(
+                    _mm256_xor_si256(d, sign), u));
+            bad = _mm256_or_si256(bad, _mm256_castps_si256(
+                    _mm256_cmp_ps(xv, yv, _CMP_UNORD_Q)));
+        }
+
+        if (!_mm256_testz_si256(bad, bad))
+            return i + ulp_flt_scalar(x + i, y + i, step, ulps);
+    }
+
+    return i + ulp_flt_scalar(x + i, y + i, len - i, ulps);
+}
+
+/*
+ * AVX2 kernel for the tolerance comparison of double arrays. An entry is
+ * accepted if the values are equal, or finite and close.
+ */
+__attribute__((target("avx2")))
+static size_t close_dbl_avx2(
+        const double *x,
+        const double *y,
+        size_t len,
+        double abs,
+        double rel)
+{
+    const size_t step = BLOCK_BYTES / sizeof (double);
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    const __m256d inf = _mm256_set1_pd(INFINITY);
+    const __m256d av = _mm256_set1_pd(abs);
+    const __m256d rv = _mm256_set1_pd(rel);
+    __m256d xv, yv, xa, ya, ok, fin, close;
+    int all = 1;
+    size_t i, j;
+
+    for (i = 0; i + step <= len; i += step)
+    {
+        for (j = i; j < i + step; j += 4)
+        {
+            xv = _mm256_loadu_pd(x + j);
+            yv = _mm256_loadu_pd(y + j);
+            xa = _mm256_andnot_pd(sign, xv);
+            ya = _mm256_andnot_pd(sign, yv);
+            fin = _mm256_and_pd(
+                    _mm256_cmp_pd(xa, inf, _CMP_LT_OQ),
+                    _mm256_cmp_pd(ya, inf, _CMP_LT_OQ));
+            close = _mm256_cmp_pd(
+                    _mm256_andnot_pd(sign, _mm256_sub_pd(xv, yv)),
+                    _mm256_max_pd(av, _mm256_mul_pd(rv, 
+                            _mm256_max_pd(xa, ya))),
+                    _CMP_LE_OQ);
+            ok = _mm256_or_pd(
+                    _mm256_cmp_pd(xv, yv, _CMP_EQ_OQ),
+                    _mm256_and_pd(fin, close));
+            all &= _mm256_movemask_pd(ok) == 0xf;
+        }
+
+        if (!all)
+            return i + close_dbl_scalar(x + i, y + i, step, abs, rel);
+    }
+
+    return i + close_dbl_scalar(x + i, y + i, len - i, abs, rel);
+}
+
+/*
+ * AVX2 kernel for the tolerance comparison of float arrays.
+ */
+__attribute__((target("avx2")))
+static size_t close_flt_avx2(
+        const float *x,
+        const float *y,
+        size_t len,
+        double abs,
+        double rel)
+{
+    const size_t step = BLOCK_BYTES / sizeof (float);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 inf = _mm256_set1_ps(INFINITY);
+    const __m256 av = _mm256_set1_ps((float) abs);
+    const __m256 rv = _mm256_set1_ps((float) rel);
+    __m256 xv, yv, xa, ya, ok, fin, close;
+    int all = 1;
+    size_t i, j;
+
+    for (i = 0; i + step <= len; i += step)
+    {
+        for (j = i; j < i + step; j += 8)
+        {
+            xv = _mm256_loadu_ps(x + j);
+            yv = _mm256_loadu_ps(y + j);
+            xa = _mm256_andnot_ps(sign, xv);
+            ya = _mm256_andnot_ps(sign, yv);
+            fin = _mm256_and_ps(
+                    _mm256_cmp_ps(xa, inf, _CMP_LT_OQ),
+                    _mm256_cmp_ps(ya, inf, _CMP_LT_OQ));
+            close = _mm256_cmp_ps(
+                    _mm256_andnot_ps(sign, _mm256_sub_ps(xv, yv)),
+                    _mm256_max_ps(av, _mm256_mul_ps(rv, 
+                            _mm256_max_ps(xa, ya))),
+                    _CMP_LE_OQ);
+            ok = _mm256_or_ps(
+                    _mm256_cmp_ps(xv, yv, _CMP_EQ_OQ),
+                    _mm256_and_ps(fin, close));
+            all &= _mm256_movemask_ps(ok) == 0xff;
+        }
+
+        if (!all)
+            return i + close_flt_scalar(x + i, y + i, step, abs, rel);
+    }
+
+    return i + close_flt_scalar(x + i, y + i, len - i, abs, rel);
+}
+
+#endif /* COMPARE_X86 */
+
+/*
+ * Kernels in use, chosen on the first comparison according to the
+ * instruction sets supported by the CPU. The CUTEST_SIMD environment
+ * variable may restrict the choice ("avx2", "sse2" or "none"). The choice
+ * is made once, since the first comparison may come from several threads
+ * of a threaded matrix comparison at the same time.
+ */
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+static size_t (*compare_bytes)(const unsigned char*, const unsigned char*,
+        size_t);
+static size_t (*compare_int)(const int*, const int*, size_t);
+static size_t (*compare_flo)(const double*, const double*, size_t, double);
+static size_t (*equal_dbl_kernel)(const double*, const double*, size_t);
+static size_t (*equal_flt_kernel)(const float*, const float*, size_t);
+static size_t (*ulp_dbl_kernel)(const double*, const double*, size_t, 
+        uint64_t);
+static size_t (*ulp_flt_kernel)(const float*, const float*, size_t, 
+        uint64_t);
+static size_t (*close_dbl_kernel)(const double*, const double*, size_t, 
+        double, double);
+static size_t (*close_flt_kernel)(const float*, const float*, size_t, 
+        double, double);
+
+/*
+ * Choose the kernels for the running CPU.
+ */
+static void select_kernels(void)
+{
+    const char *env = getenv("CUTEST_SIMD");
+
+    compare_bytes = compare_bytes_scalar;
+    ulp_dbl_kernel = ulp_dbl_scalar;
+    ulp_flt_kernel = ulp_flt_scalar;
+    close_dbl_kernel = close_dbl_scalar;
+    close_flt_kernel = close_flt_scalar;
+    compare_int = compare_int_scalar;
+    compare_flo = compare_flo_scalar;
+    equal_dbl_kernel = equal_dbl_scalar;
+    equal_flt_kernel = equal_flt_scalar;
+
+#ifdef COMPARE_X86
+    if (env != NULL && strcmp(env, "none") == 0)
+        return;
+
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("sse2"))
+    {
+        compare_bytes = compare_bytes_sse2;
+        compare_int = compare_int_sse2;
+        compare_flo = compare_flo_sse2;
+        equal_dbl_kernel = equal_dbl_sse2;
+        equal_flt_kernel = equal_flt_sse2;
+    }
+
+    if (env != NULL && strcmp(env, "sse2") == 0)
+        return;
+
+    if (__builtin_cpu_supports("avx2"))
+    {
+        compare_bytes = compare_bytes_avx2;
+        ulp_dbl_kernel = ulp_dbl_avx2;
+        ulp_flt_kernel = ulp_flt_avx2;
+        close_dbl_kernel = close_dbl_avx2;
+        close_flt_kernel = close_flt_avx2;
+        compare_int = compare_int_avx2;
+        compare_flo = compare_flo_avx2;
+        equal_dbl_kernel = equal_dbl_avx2;
+        equal_flt_kernel = equal_flt_avx2;
+    }
+#else
+    (void) env;
+#endif
+}
+
+/*!
+ * Return the offset of the first different byte of two buffers, or len if
+ * they are equal.
+ */
+size_t __compare_bytes(const void *x, const void *y, size_t len)
+{
+    pthread_once(&kernels_once, select_kernels);
+
+    return compare_bytes(x, y, len);
+}
+
+/*!
+ * Return the position of the first different entry of two int arrays, or
+ * len if they are equal.
+ */
+size_t __compare_int(const int *x, const int *y, size_t len)
+{
+    pthread_once(&kernels_once, select_kernels);
+
+    return compare_int(x, y, len);
+}
+
+/*!
+ * Return the position of the first entries of two double arrays whose
+ * difference exceeds the tolerance, or len if there is none.
+ */
+size_t __compare_flo(const double *x, const double *y, size_t len, double tol)
+{
+    pthread_once(&kernels_once, select_kernels);
+
+    return compare_flo(x, y, len, tol);
+}
+
+/*!
+ * Return the position of the first entries of two double arrays which are
+ * not equal, or len if there is none.
+ */
+size_t __compare_equal_dbl(const double *x, const double *y, size_t len)
+{
+    pthread_once(&kernels_once, select_kernels);
+
+    return equal_dbl_kernel(x, y, len);
+}
+
+/*!
+ * Return the position of the first entries of two float arrays which are
+ * not equal, or len if there is none.
+ */
+size_t __compare_equal_flt(const float *x, const float *y, size_t len)
+{
+    pthread_once(&kernels_once, select_kernels);
+
+    return equal_flt_kernel(x, y, len);
+}
+
+/*
+ * Size of the entries of each type code.
+ */
+static const size_t type_sizes[] = {
+    [TYPE_CHAR] = sizeof (char),
+    [TYPE_SCHAR] = sizeof (signed char),
+    [TYPE_UCHAR] = sizeof (unsigned char),
+    [TYPE_SHORT] = sizeof (short),
+    [TYPE_USHORT] = sizeof (unsigned short),
+    [TYPE_INT] = sizeof (int),
+    [TYPE_UINT] = sizeof (unsigned int),
+    [TYPE_LONG] = sizeof (long),
+    [TYPE_ULONG] = sizeof (unsigned long),
+    [TYPE_LONGLONG] = sizeof (long long),
+    [TYPE_ULONGLONG] = sizeof (unsigned long long),
+    [TYPE_FLOAT] = sizeof (float),
+    [TYPE_DOUBLE] = sizeof (double),
+};
+
+/*!
+ * Return the size of the entries of the given type code.
+ */
+size_t __type_size(int type)
+{
+    return type_sizes[type];
+}
+
+/*!
+ * Write the value of an entry of the given type code.
+ */
+void __format_entry(char *buf, size_t len, const void *p, int type)
+{
+    switch (type)
+    {
+        case TYPE_CHAR: 
+            snprintf(buf, len, "%d", *(const char*) p); 
+            break;
+        case TYPE_SCHAR: 
+            snprintf(buf, len, "%d", *(const signed char*) p); 
+            break;
+        case TYPE_UCHAR: 
+            snprintf(buf, len, "%u", *(const unsigned char*) p); 
+            break;
+        case TYPE_SHORT: 
+            snprintf(buf, len, "%d", *(const short*) p); 
+            break;
+        case TYPE_USHORT: 
+            snprintf(buf, len, "%u", *(const unsigned short*) p); 
+            break;
+        case TYPE_INT: 
+            snprintf(buf, len, "%d", *(const int*) p); 
+            break;
+        case TYPE_UINT: 
+            snprintf(buf, len, "%u", *(const unsigned int*) p); 
+            break;
+        case TYPE_LONG: 
+            snprintf(buf, len, "%ld", *(const long*) p); 
+            break;
+        case TYPE_ULONG: 
+            snprintf(buf, len, "%lu", *(const unsigned long*) p); 
+            break;
+        case TYPE_LONGLONG: 
+            snprintf(buf, len, "%lld", *(const long long*) p); 
+            break;
+        case TYPE_ULONGLONG: 
+            snprintf(buf, len, "%llu", *(const unsigned long long*) p); 
+            break;
+        case TYPE_FLOAT: 
+            snprintf(buf, len, "%.9g", *(const float*) p); 
+            break;
+        case TYPE_DOUBLE: 
+            snprintf(buf, len, "%.17g", *(const double*) p); 
+            break;
+    }
+}
+
+/*!
+ * Compare two double arrays entry by entry, with a tolerance in units in
+ * the last place, and describe the entries out of tolerance.
+ */
+size_t __compare_ulp_dbl(
+        const double *x,
+        const double *y,
+        size_t len,
+        uint64_t ulps,
+        Mismatch *mm)
+{
+    uint64_t d;
+    size_t i;
+
+    pthread_once(&kernels_once, select_kernels);
+
+    mm->count = 0;
+    mm->error = 0.0;
+    for (i = ulp_dbl_kernel(x, y, len, ulps); i < len; ++i)
+    {
+        d = ulp_dbl(x[i], y[i]);
+        if (d <= ulps && d != UINT64_MAX)
+            continue;
+        if (mm->count++ == 0 || (double) d > mm->error)
+        {
+            mm->worst = i;
+            mm->error = d == UINT64_MAX ? INFINITY : (double) d;
+        }
+    }
+
+    return mm->count;
+}
+
+/*!
+ * Compare two float arrays entry by entry, with a tolerance in units in
+ * the last place, and describe the entries out of tolerance.
+ */
+size_t __compare_ulp_flt(
+        const float *x,
+        const float *y,
+        size_t len,
+        uint64_t ulps,
+        Mismatch *mm)
+{
+    uint32_t d;
+    size_t i;
+
+    pthread_once(&kernels_once, select_kernels);
+
+    mm->count = 0;
+    mm->error = 0.0;
+    for (i = ulp_flt_kernel(x, y, len, ulps); i < len; ++i)
+    {
+        d = ulp_flt(x[i], y[i]);
+        if (d <= ulps && d != UINT32_MAX)
+            continue;
+        if (mm->count++ == 0 || (double) d > mm->error)
+        {
+            mm->worst = i;
+            mm->error = d == UINT32_MAX ? INFINITY : (double) d;
+        }
+    }
+
+    return mm->count;
+}
+
+/*!
+ * Compare two double arrays entry by entry, with an absolute and a 
+ * relative tolerance, and describe the entries out of tolerance.
+ */
+size_t __compare_close_dbl(
+        const double *x,
+        const double *y,
+        size_t len,
+        double abs,
+        double rel,
+        Mismatch *mm)
+{
+    double e;
+    size_t i;
+
+    pthread_once(&kernels_once, select_kernels);
+
+    mm->count = 0;
+    mm->error = 0.0;
+    for (i = close_dbl_kernel(x, y, len, abs, rel); i < len; ++i)
+    {
+        if (close_dbl(x[i], y[i], abs, rel))
+            continue;
+        e = close_error(x[i], y[i], abs, rel);
+        if (mm->count++ == 0 || e > mm->error)
+        {
+            mm->worst = i;
+            mm->error = e;
+        }
+    }
+
+    return mm->count;
+}
+
+/*!
+ * Compare two float arrays entry by entry, with an absolute and a 
+ * relative tolerance, and describe the entries out of tolerance.
+ */
+size_t __compare_close_flt(
+        const float *x,
+        const float *y,
+        size_t len,
+        double abs,
+        double rel,
+        Mismatch *mm)
+{
+    double e;
+    size_t i;
+
+    pthread_once(&kernels_once, select_kernels);
+
+    mm->count = 0;
+    mm->error = 0.0;
+    for (i = close_flt_kernel(x, y, len, abs, rel); i < len; ++i)
+    {
+        if (close_flt(x[i], y[i], (float) abs, (float) rel))
+            continue;
+        e = close_error(x[i], y[i], abs, rel);
+        if (mm->count++ == 0 || e > mm->error)
+        {
+            mm->worst = i;
+            mm->error = e;
+        }
+    }
+
+    return mm->count;
+}
@@ -24,281 +24,1700 @@
  * @date 2015-01-13
  */
 
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <setjmp.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include "cutest.h"
 
+/*
+ * Size of the alternate stack used to handle signals in SUITE_NOFORK mode,
+ * which must be usable also after a stack overflow.
+ */
+#define ALTSTACK_SIZE (64 * 1024)
+
+/*
+ * Initial size of the array of test cases of a suite.
+ */
+#define TESTS_MIN_CAP 16
+
+/*
+ * Attributes attached to test case functions with the TEST_CASE_*(name)
+ * macros, recorded before main() is entered.
+ */
+static Test_attr *attrs = NULL;
+static int attrs_len = 0;
+
+/*
+ * Number of failed test cases in all the suite runs of the process.
+ */
+static int failures_total = 0;
+
+/*
+ * Nonzero when the peak resident set size of the process has been reset
+ * at the start of the current test case.
+ */
+static int peak_rss_known = 0;
+
+/*
+ * Delimiters of the section containing the descriptors of the test cases
+ * registered automatically, defined by the linker. They are weak, so that
+ * they are NULL when no test case is registered.
+ */
+extern Test_case __start_cutest_tests[] __attribute__((weak));
+extern Test_case __stop_cutest_tests[] __attribute__((weak));
+
+/*
+ * State of the in-process execution: signals caught in SUITE_NOFORK mode,
+ * the jump buffer used to recover from them, and a flag telling whether 
+ * code under test is being executed. SIGALRM is raised by the timer
+ * enforcing the timeout of the test case.
+ */
+static const int nofork_signals[] = {
+    SIGSEGV, SIGFPE, SIGABRT, SIGBUS, SIGILL, SIGALRM
+};
+static sigjmp_buf nofork_env;
+static volatile sig_atomic_t nofork_active = 0;
+
 /*!
  * Initialize a new suite, allocating memory for it and setting all entries
  * to default values. A newly initialized contains no test cases.
  */
-int suite_new(
-        Suite **s,
-        const char *name,
-        void (*bef)(void),
-        void (*aft)(void))
+int suite_new(
+        Suite **s,
+        const char *name,
+        void (*bef)(void),
+        void (*aft)(void))
+{
+    return suite_new_all(s, name, bef, aft, NULL, NULL);
+}
+
+/*!
+ * Initialize a new suite, with the procedures executed before and after
+ * each test case, and the ones executed once per suite run.
+ */
+int suite_new_all(
+        Suite **s,
+        const char *name,
+        void (*bef)(void),
+        void (*aft)(void),
+        void (*bef_all)(void),
+        void (*aft_all)(void))
+{
+    *s = (Suite*) malloc(sizeof (Suite));
+
+    if (*s == NULL)
+    {
+        perror("suite_new: malloc error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    (*s)->tests = NULL;
+    (*s)->tests_len = 0;
+    (*s)->tests_cap = 0;
+    ll_init(&(*s)->benchmarks);
+    snprintf((*s)->name, NAME_LEN, "%s", name);
+    (*s)->before = bef;
+    (*s)->after = aft;
+    (*s)->before_all = bef_all;
+    (*s)->after_all = aft_all;
+    (*s)->mode = SUITE_FORK;
+    (*s)->timeout = 0;
+
+    return 0;
+}
+
+/*!
+ * Add the test case to the suite, labelling the test with the provided
+ * name.
+ */
+int suite_add(Suite *s, void (*t)(Status*), const char *name)
+{
+    Test_case *tc;
+    int i;
+
+    if (s->tests_len == s->tests_cap) /* grow the array geometrically */
+    {
+        s->tests_cap = s->tests_cap > 0 ? 2 * s->tests_cap : TESTS_MIN_CAP;
+        tc = (Test_case*) realloc(s->tests, s->tests_cap * sizeof (Test_case));
+        if (tc == NULL)
+        {
+            perror("suite_add: malloc error.\n");
+            exit(EXIT_FAILURE);
+        }
+        s->tests = tc;
+    }
+
+    tc = &s->tests[s->tests_len++];
+
+    tc->fun = t;
+    snprintf(tc->name, NAME_LEN, "%s", name);
+    tc->flags = 0;
+    tc->timeout = 0;
+    tc->file = NULL;
+    tc->line = 0;
+
+    for (i = 0; i < attrs_len; i++)
+    {
+        if (attrs[i].fun == t)
+        {
+            tc->flags = attrs[i].flags;
+            tc->timeout = attrs[i].timeout;
+        }
+    }
+
+    return 0;
+}
+
+/*!
+ * Add the benchmark to the suite, labelling it with the provided name.
+ */
+int suite_add_benchmark(Suite *s, void (*b)(Bench*), const char *name)
+{
+    Benchmark *bm = (Benchmark*) malloc(sizeof (Benchmark));
+
+    if (bm == NULL)
+    {
+        perror("suite_add_benchmark: malloc error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    bm->fun = b;
+    snprintf(bm->name, NAME_LEN, "%s", name);
+
+    ll_push_front(&s->benchmarks, (void*) bm);
+
+    return 0;
+}
+
+/*!
+ * Record the attributes of a test case function, to be applied when the
+ * function is added to a suite.
+ */
+int __test_set_attr(void (*fun)(Status*), int flags, long timeout)
+{
+    Test_attr *a = (Test_attr*) realloc(
+            attrs,
+            (attrs_len + 1) * sizeof (Test_attr));
+
+    if (a == NULL)
+    {
+        perror("__test_set_attr: malloc error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    attrs = a;
+    attrs[attrs_len].fun = fun;
+    attrs[attrs_len].flags = flags;
+    attrs[attrs_len].timeout = timeout;
+    attrs_len++;
+
+    return 0;
+}
+
+/*!
+ * Set the execution mode for the suite.
+ */
+int suite_set_mode(Suite *s, int mode)
+{
+    s->mode = mode;
+    return 0;
+}
+
+/*!
+ * Set the timeout for the test cases of the suite.
+ */
+int suite_set_timeout(Suite *s, long ms)
+{
+    s->timeout = ms;
+    return 0;
+}
+
+/*
+ * Default timeout for the test cases of a suite run, in milliseconds. The
+ * timeout of the suite, if set, has precedence over the CUTEST_TIMEOUT 
+ * environment variable. Zero means no timeout.
+ */
+static long get_timeout(Suite *s)
+{
+    const char *env = getenv("CUTEST_TIMEOUT");
+
+    if (s->timeout > 0)
+        return s->timeout;
+
+    if (env != NULL && *env != '\0' && atol(env) > 0)
+        return atol(env);
+
+    return 0;
+}
+
+/*
+ * Current time from a monotonic clock, in microseconds.
+ */
+static long now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * Current time from a monotonic clock, in milliseconds.
+ */
+static long now_ms(void)
+{
+    return now_us() / 1000;
+}
+
+/*
+ * Convert a resource usage into metrics. The wall time is not set.
+ */
+static void get_metrics(Metrics *m, struct rusage *ru)
+{
+    m->wall_us = 0;
+    m->user_us = ru->ru_utime.tv_sec * 1000000 + ru->ru_utime.tv_usec;
+    m->sys_us = ru->ru_stime.tv_sec * 1000000 + ru->ru_stime.tv_usec;
+    m->max_rss = ru->ru_maxrss;
+    m->minflt = ru->ru_minflt;
+    m->majflt = ru->ru_majflt;
+    m->nvcsw = ru->ru_nvcsw;
+    m->nivcsw = ru->ru_nivcsw;
+}
+
+/*
+ * Add (sign = 1) or subtract (sign = -1) the counters of two metrics. The
+ * maximum resident set size is not a counter, so the maximum is kept.
+ */
+static void add_metrics(Metrics *m, const Metrics *o, int sign)
+{
+    m->wall_us += sign * o->wall_us;
+    m->user_us += sign * o->user_us;
+    m->sys_us += sign * o->sys_us;
+    m->minflt += sign * o->minflt;
+    m->majflt += sign * o->majflt;
+    m->nvcsw += sign * o->nvcsw;
+    m->nivcsw += sign * o->nivcsw;
+    if (o->max_rss > m->max_rss)
+        m->max_rss = o->max_rss;
+}
+
+/*!
+ * Reset the peak resident set size of the calling process to its current
+ * resident set size. Return 0 on success, -1 if the peak cannot be reset.
+ */
+int __peak_rss_reset(void)
+{
+    int fd = open("/proc/self/clear_refs", O_WRONLY | O_CLOEXEC);
+
+    peak_rss_known = 0;
+    if (fd == -1)
+        return -1;
+
+    peak_rss_known = write(fd, "5", 1) == 1;
+    close(fd);
+
+    return peak_rss_known ? 0 : -1;
+}
+
+/*!
+ * Return the peak resident set size of the calling process since the last
+ * reset, in kilobytes, or 0 if it cannot be read or was not reset.
+ */
+long __peak_rss(void)
+{
+    char line[128];
+    long kb = 0;
+    FILE *f;
+
+    if (!peak_rss_known || (f = fopen("/proc/self/status", "r")) == NULL)
+        return 0;
+
+    while (fgets(line, sizeof (line), f) != NULL)
+        if (sscanf(line, "VmHWM: %ld kB", &kb) == 1)
+            break;
+
+    fclose(f);
+    return kb;
+}
+
+/*
+ * Execution mode to be used for a suite run. The mode of the suite is
+ * overridden by the CUTEST_MODE environment variable.
+ */
+static int get_mode(Suite *s)
+{
+    const char *env = getenv("CUTEST_MODE");
+
+    if (env != NULL && !strcmp(env, "fork"))
+        return SUITE_FORK;
+    if (env != NULL && !strcmp(env, "nofork"))
+        return SUITE_NOFORK;
+    if (env != NULL && !strcmp(env, "workers"))
+        return SUITE_WORKERS;
+
+    return s->mode;
+}
+
+/*
+ * Number of parallel jobs to be used for a suite run. The value requested
+ * by the caller is overridden by the CUTEST_JOBS environment variable, and
+ * a non-positive value means one job per online processor.
+ */
+static int get_jobs(int jobs)
+{
+    const char *env = getenv("CUTEST_JOBS");
+
+    if (env != NULL && *env != '\0')
+        jobs = atoi(env);
+
+    if (jobs < 1)
+        jobs = (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+    return jobs < 1 ? 1 : jobs;
+}
+
+/*
+ * Copy a string in newly allocated memory.
+ */
+static char* copy_string(const char *str)
+{
+    char *res = (char*) malloc(strlen(str) + 1);
+
+    if (res == NULL)
+    {
+        perror("suite_run: malloc error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return strcpy(res, str);
+}
+
+/*
+ * Record in the result the status of a completed test case. Strings are
+ * copied only for failed or invalid assertions.
+ */
+static void collect_status(
+        Result *res,
+        const Status *st,
+        const char *assertion,
+        const char *file)
+{
+    res->failed = st->failed;
+    res->invalid = st->invalid;
+
+    if (!st->failed && !st->invalid)
+        return;
+
+    res->assertion = copy_string(assertion);
+    res->file = copy_string(file);
+    res->line = st->line;
+    if (st->message[0] != '\0')
+        res->message = copy_string(st->message);
+}
+
+/*
+ * Copy by value, inside the channel, the assertion and the file name of
+ * a failed or invalid assertion, which are referenced by the status.
+ */
+static void save_status(Channel *c)
+{
+    if (!c->st.failed && !c->st.invalid)
+        return;
+
+    snprintf(c->assertion, ASSERTION_LEN, "%s", c->st.assertion);
+    snprintf(c->file, FILE_LEN, "%s", c->st.file);
+}
+
+/*
+ * Execute a test case inside a child process. The BEFORE_TEST procedure,
+ * the test case and the AFTER_TEST procedure run in the same process, so
+ * the state set up by the first is seen by the others. The phase in
+ * execution and the status of the test case are written directly to the
+ * shared channel, so the runner knows which phase was in execution if the
+ * child terminates.
+ */
+static void run_in_child(Suite *s, Test_case *tc, Channel *c)
+{
+    int track = __track_alloc();
+    int perf = __perf_enabled();
+
+    c->st.failed = 0;
+    c->st.invalid = 0;
+    c->st.message[0] = '\0';
+    memset(&c->alloc, 0, sizeof (Alloc_stats));
+    memset(&c->perf, 0, sizeof (Perf_counters));
+    __peak_rss_reset();
+
+    if (track)
+        __alloc_start();
+
+    if (s->before != NULL)
+    {
+        c->phase = PHASE_BEFORE;
+        s->before();
+    }
+
+    c->phase = PHASE_TEST;
+    __alloc_thread_reset();
+    if (perf)
+        __perf_start();
+    tc->fun(&c->st); /* run test case function */
+    __alloc_regions_check(&c->st);
+    if (perf)
+        __perf_stop(&c->perf);
+    save_status(c);
+    c->phase = PHASE_AFTER;
+
+    if (s->after != NULL)
+        s->after();
+
+    if (track)
+        __alloc_stop(&c->alloc);
+}
+
+/*
+ * Main loop of a persistent worker. The worker reads the indexes of the
+ * test cases to be executed from the command pipe, and notifies the end
+ * of each one writing a byte to its pipe. It terminates when the command
+ * pipe is closed.
+ */
+static void run_worker(Runner *r, Channel *c, int cmd, int fd)
+{
+    struct rusage ru;
+    char done = 0;
+    int i;
+
+    while (read(cmd, &i, sizeof (int)) == sizeof (int))
+    {
+        getrusage(RUSAGE_SELF, &ru);
+        get_metrics(&c->base, &ru);
+        c->base.max_rss = 0;
+
+        run_in_child(r->s, r->tcs[i], c); /* resets the peak RSS */
+        fflush(NULL);
+
+        /* the peak of getrusage() covers the previous test cases too */
+        getrusage(RUSAGE_SELF, &ru);
+        get_metrics(&c->m, &ru);
+        c->m.max_rss = __peak_rss();
+
+        write(fd, &done, 1);
+    }
+
+    exit(0);
+}
+
+/*
+ * Execute the role of a child process started for a slot, and terminate.
+ * The child may be:
+ *  - a worker (when worker is nonzero), executing test cases on command;
+ *  - a process executing the test case tc;
+ *  - a process executing the AFTER_TEST procedure only (when cleanup is 
+ *    nonzero), which is needed when the test case process has been lost.
+ */
+__attribute__((noreturn))
+static void run_child(
+        Runner *r,
+        Channel *c,
+        Test_case *tc,
+        int worker,
+        int cleanup,
+        int cmd,
+        int fd)
+{
+    signal(SIGPIPE, SIG_DFL);
+
+    if (worker)
+        run_worker(r, c, cmd, fd);
+
+    if (cleanup)
+        r->s->after();
+    else
+        run_in_child(r->s, tc, c);
+    exit(0);
+}
+
+/*
+ * Send to the runner the pid of a child forked by the fixture process,
+ * with the runner ends of its pipes.
+ */
+static void send_child(int sock, pid_t pid, const int *fds, int n)
+{
+    struct msghdr msg = {};
+    struct iovec iov;
+    struct cmsghdr *cm;
+    union
+    {
+        char buf[CMSG_SPACE(2 * sizeof (int))];
+        struct cmsghdr align;
+    } u;
+
+    iov.iov_base = &pid;
+    iov.iov_len = sizeof (pid_t);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    if (n > 0)
+    {
+        msg.msg_control = u.buf;
+        msg.msg_controllen = CMSG_SPACE(n * sizeof (int));
+        cm = CMSG_FIRSTHDR(&msg);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type = SCM_RIGHTS;
+        cm->cmsg_len = CMSG_LEN(n * sizeof (int));
+        memcpy(CMSG_DATA(cm), fds, n * sizeof (int));
+    }
+
+    if (sendmsg(sock, &msg, 0) == -1)
+    {
+        perror("suite_run: sendmsg error.\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*
+ * Fork a child requested by the runner from the fixture process, so that
+ * it inherits the state set up by BEFORE_ALL copy-on-write. The child is
+ * forked by an intermediate process, which terminates immediately: the
+ * child is then adopted by the runner, subreaper of its descendants, 
+ * which collects its termination as for its own children.
+ */
+static void serve_request(Runner *r, int sock, const Fork_request *req)
+{
+    Channel *c = &r->chans[req->slot];
+    int fd[2];
+    int cmd[2] = {-1, -1};
+    int ends[2];
+    pid_t pid;
+
+    if (pipe(fd) || (req->worker && pipe(cmd)))
+    {
+        perror("suite_run: pipe error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    fflush(NULL); /* do not duplicate pending output in the child */
+
+    c->child = -1;
+    pid = fork();
+    switch (pid)
+    {
+        case -1:
+            perror("suite_run: fork error.\n");
+            exit(EXIT_FAILURE);
+
+        case 0: /* intermediate process: fork the child and quit */
+            pid = fork();
+            if (pid != 0)
+            {
+                c->child = pid;
+                exit(0);
+            }
+
+            close(sock);
+            close(fd[0]);
+            if (req->worker)
+                close(cmd[1]);
+            run_child(r, c, r->tcs[req->test], req->worker, req->cleanup,
+                    cmd[0], fd[1]);
+
+        default: /* fixture: pass the runner ends of the pipes */
+            while (waitpid(pid, NULL, 0) == -1 && errno == EINTR)
+                ;
+    }
+
+    close(fd[1]);
+    if (req->worker)
+        close(cmd[0]);
+
+    ends[0] = fd[0];
+    ends[1] = cmd[1];
+    send_child(sock, c->child, ends, c->child > 0 ? 1 + req->worker : 0);
+
+    close(fd[0]);
+    if (req->worker)
+        close(cmd[1]);
+}
+
+/*
+ * Main loop of the fixture process. The BEFORE_ALL procedure is executed
+ * once, then the runner is notified writing a byte to the socket, and the
+ * children it requests are forked from the resulting state. When the
+ * socket is closed, the AFTER_ALL procedure is executed.
+ */
+static void run_fixture(Runner *r, int sock)
+{
+    Fork_request req;
+    char ready = 0;
+
+    signal(SIGPIPE, SIG_DFL);
+
+    if (r->s->before_all != NULL)
+        r->s->before_all();
+    fflush(NULL);
+    write(sock, &ready, 1);
+
+    while (read(sock, &req, sizeof (Fork_request)) == sizeof (Fork_request))
+        serve_request(r, sock, &req);
+
+    if (r->s->after_all != NULL)
+        r->s->after_all();
+    exit(0);
+}
+
+/*
+ * Obtain from the fixture process a child for the slot, receiving its pid
+ * and the runner ends of its pipes.
+ */
+static void fork_from_fixture(Runner *r, Slot *sl, int worker, int cleanup)
+{
+    Fork_request req;
+    struct msghdr msg = {};
+    struct iovec iov;
+    struct cmsghdr *cm;
+    union
+    {
+        char buf[CMSG_SPACE(2 * sizeof (int))];
+        struct cmsghdr align;
+    } u;
+    int fds[2] = {-1, -1};
+    ssize_t n;
+
+    req.slot = sl - r->slots;
+    req.test = sl->res - r->results;
+    req.worker = worker;
+    req.cleanup = cleanup;
+
+    if (write(r->fixture, &req, sizeof (Fork_request)) 
+            != sizeof (Fork_request))
+    {
+        perror("suite_run: fixture write error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    iov.iov_base = &sl->pid;
+    iov.iov_len = sizeof (pid_t);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = u.buf;
+    msg.msg_controllen = sizeof (u.buf);
+
+    while ((n = recvmsg(r->fixture, &msg, 0)) == -1 && errno == EINTR)
+        ;
+
+    if (n != sizeof (pid_t) || sl->pid <= 0)
+    {
+        perror("suite_run: fixture fork error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    cm = CMSG_FIRSTHDR(&msg);
+    if (cm != NULL && cm->cmsg_type == SCM_RIGHTS)
+        memcpy(fds, CMSG_DATA(cm), cm->cmsg_len - CMSG_LEN(0));
+
+    sl->fd = fds[0];
+    sl->cmd = worker ? fds[1] : -1;
+}
+
+/*
+ * Start a child process in the given slot, with the role described in
+ * run_child(). The child writes its results to the shared channel of the
+ * slot, and uses its own pipe to notify the runner, so that concurrent
+ * children never contend for a resource. When the suite has a fixture 
+ * process, the child is forked by it.
+ */
+static void spawn_child(Runner *r, Slot *sl, int worker, int cleanup)
+{
+    int fd[2];
+    int cmd[2] = {-1, -1};
+    int i;
+
+    sl->cleanup = cleanup;
+    sl->killed = 0;
+    sl->chan->phase = 0;
+    memset(&sl->chan->base, 0, sizeof (Metrics));
+
+    if (r->fixture >= 0)
+    {
+        fork_from_fixture(r, sl, worker, cleanup);
+        return;
+    }
+
+    if (pipe(fd) || (worker && pipe(cmd)))
+    {
+        perror("suite_run: pipe error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    fflush(NULL); /* do not duplicate pending output in the child */
+
+    sl->pid = fork();
+    switch (sl->pid)
+    {
+        case -1:
+            perror("suite_run: fork error.\n");
+            exit(EXIT_FAILURE);
+
+        case 0: /* child: exec the test case, write results and exit */
+            close(fd[0]);
+            for (i = 0; i < r->jobs; i++) /* pipes of the other children */
+            {
+                if (&r->slots[i] == sl || r->slots[i].pid == 0)
+                    continue;
+                close(r->slots[i].fd);
+                if (r->slots[i].cmd >= 0)
+                    close(r->slots[i].cmd);
+            }
+            if (worker)
+                close(cmd[1]);
+            run_child(r, sl->chan, sl->tc, worker, cleanup, cmd[0], fd[1]);
+
+        default: /* parent: keep the read end only */
+            close(fd[1]);
+            sl->fd = fd[0];
+            if (worker)
+                close(cmd[0]);
+            sl->cmd = cmd[1];
+    }
+}
+
+/*
+ * Terminate the idle worker of a slot, if any, closing its command pipe.
+ */
+static void stop_worker(Slot *sl)
+{
+    if (sl->pid == 0)
+        return;
+
+    close(sl->cmd);
+    close(sl->fd);
+    waitpid(sl->pid, NULL, 0);
+    sl->pid = 0;
+}
+
+/*
+ * Start the execution of a test case in a free slot. With persistent 
+ * workers, the test case is sent to the worker of the slot, which is 
+ * spawned if not running. Otherwise, and for test cases which must run
+ * in a process of their own, a new child is created for the test case.
+ */
+static void start_test(Runner *r, Slot *sl, int i)
+{
+    sl->tc = r->tcs[i];
+    sl->res = &r->results[i];
+    sl->timeout = sl->tc->timeout > 0 ? sl->tc->timeout : r->timeout;
+    sl->deadline = sl->timeout > 0 ? now_ms() + sl->timeout : 0;
+    sl->start = now_us();
+
+    if (r->mode != SUITE_WORKERS || (sl->tc->flags & TEST_FORK))
+    {
+        stop_worker(sl);
+        spawn_child(r, sl, 0, 0);
+        return;
+    }
+
+    if (sl->pid == 0)
+        spawn_child(r, sl, 1, 0);
+
+    sl->chan->phase = 0;
+    write(sl->cmd, &i, sizeof (int));
+}
+
+/*
+ * Mark a result as complete, counting the failed test cases of the
+ * process for the fail fast option.
+ */
+static void finish_result(Result *res)
+{
+    res->done = 1;
+    if (__result_outcome(res) != OUTCOME_SUCCESS)
+        failures_total++;
+}
+
+/*
+ * Mark the test case of a slot as complete, and release the slot.
+ */
+static void complete_test(Slot *sl)
+{
+    sl->res->m.wall_us = now_us() - sl->start;
+    finish_result(sl->res);
+    sl->res = NULL;
+}
+
+/*
+ * Collect the termination of the child running in the slot, and record
+ * the outcome of the phase it was executing and the resources used. The
+ * slot is released when the test case execution is complete.
+ */
+static void end_test(Runner *r, Slot *sl, int status, struct rusage *ru)
+{
+    Result *res = sl->res;
+    Channel *c = sl->chan;
+    Metrics m;
+    int sig = 0;
+    int code = 0;
+
+    sl->pid = 0;
+
+    get_metrics(&m, ru);
+    add_metrics(&m, &c->base, -1);
+    add_metrics(&res->m, &m, 1);
+
+    if (WIFSIGNALED(status)) /* child process signaled */
+        sig = WTERMSIG(status);
+    else /* child process exited, possibly with a failure status */
+        code = WEXITSTATUS(status);
+
+    if (sl->cleanup) /* AFTER_TEST run on its own, after a lost test */
+    {
+        res->cleanup_sig = sig;
+        res->cleanup_status = code;
+        if (sl->killed)
+            res->cleanup_timeout = sl->timeout;
+        complete_test(sl);
+        return;
+    }
+
+    switch (c->phase)
+    {
+        case PHASE_BEFORE: /* terminated inside BEFORE_TEST */
+            res->error = PHASE_BEFORE;
+            break;
+
+        case PHASE_TEST: /* terminated inside the test case */
+            res->error = PHASE_TEST;
+            break;
+
+        case PHASE_AFTER: /* test case completed */
+            collect_status(res, &c->st, c->assertion, c->file);
+            res->alloc = c->alloc;
+            res->perf = c->perf;
+            res->cleanup_sig = sig;
+            res->cleanup_status = code;
+            if (sl->killed)
+                res->cleanup_timeout = sl->timeout;
+            break;
+
+        default: /* terminated before reporting anything */
+            res->error = r->s->before != NULL ? PHASE_BEFORE : PHASE_TEST;
+    }
+
+    if (res->error)
+    {
+        res->term_sig = sig;
+        res->exit_status = code;
+        if (sl->killed)
+            res->timeout = sl->timeout;
+    }
+
+    if (res->error == PHASE_TEST && r->s->after != NULL)
+    {
+        spawn_child(r, sl, 0, 1); /* AFTER_TEST is guaranteed anyway */
+        if (sl->timeout > 0)
+            sl->deadline = now_ms() + sl->timeout;
+        return;
+    }
+
+    complete_test(sl);
+}
+
+/*
+ * Handle a busy slot whose pipe is ready. When a worker completes a test
+ * case, the slot is released and the worker is kept for the next test
+ * case. When the pipe is closed the child has terminated, so it is
+ * collected.
+ */
+static void read_slot(Runner *r, Slot *sl)
+{
+    Channel *c = sl->chan;
+    struct rusage ru;
+    char done;
+    int status;
+
+    if (read(sl->fd, &done, 1) == 1) /* test case completed by a worker */
+    {
+        collect_status(sl->res, &c->st, c->assertion, c->file);
+        sl->res->alloc = c->alloc;
+        sl->res->perf = c->perf;
+        sl->res->m = c->m;
+        add_metrics(&sl->res->m, &c->base, -1);
+        complete_test(sl);
+        return;
+    }
+
+    close(sl->fd);
+    if (sl->cmd >= 0)
+        close(sl->cmd);
+
+    while (wait4(sl->pid, &status, 0, &ru) == -1 && errno == EINTR)
+        ;
+    end_test(r, sl, status, &ru);
+}
+
+/*
+ * Kill the children of the busy slots whose deadline has expired, and
+ * return the time to wait for the next deadline, in milliseconds, or -1
+ * if there are no deadlines.
+ */
+static int check_deadlines(Runner *r)
+{
+    long now = now_ms();
+    long wait = -1;
+    int i;
+    Slot *sl;
+
+    for (i = 0; i < r->jobs; i++)
+    {
+        sl = &r->slots[i];
+        if (sl->res == NULL || sl->deadline == 0 || sl->killed)
+            continue;
+
+        if (now >= sl->deadline)
+        {
+            kill(sl->pid, SIGKILL);
+            sl->killed = 1;
+            continue;
+        }
+
+        if (wait < 0 || sl->deadline - now < wait)
+            wait = sl->deadline - now;
+    }
+
+    return (int) wait;
+}
+
+/*
+ * Signal handler for SUITE_NOFORK mode. When the signal is raised by the
+ * code under test, jump back to the runner, otherwise fall back to the
+ * default action.
+ */
+static void nofork_handler(int sig)
+{
+    if (nofork_active)
+        siglongjmp(nofork_env, sig);
+
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+/*
+ * Install the signal handlers for SUITE_NOFORK mode, on an alternate 
+ * stack, saving the previous dispositions and stack.
+ */
+static void nofork_setup(struct sigaction *old, stack_t *old_ss)
+{
+    struct sigaction sa;
+    stack_t ss;
+    size_t i;
+
+    ss.ss_sp = malloc(ALTSTACK_SIZE);
+    ss.ss_size = ALTSTACK_SIZE;
+    ss.ss_flags = 0;
+    if (ss.ss_sp == NULL)
+    {
+        perror("suite_run: malloc error.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (sigaltstack(&ss, old_ss))
+    {
+        perror("suite_run: sigaltstack error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    memset(&sa, 0, sizeof (sa));
+    sa.sa_handler = nofork_handler;
+    sa.sa_flags = SA_ONSTACK;
+    sigemptyset(&sa.sa_mask);
+
+    for (i = 0; i < sizeof (nofork_signals) / sizeof (int); i++)
+        sigaction(nofork_signals[i], &sa, &old[i]);
+}
+
+/*
+ * Restore the signal dispositions and stack saved by nofork_setup().
+ */
+static void nofork_cleanup(struct sigaction *old, stack_t *old_ss)
+{
+    stack_t ss;
+    size_t i;
+
+    for (i = 0; i < sizeof (nofork_signals) / sizeof (int); i++)
+        sigaction(nofork_signals[i], &old[i], NULL);
+
+    sigaltstack(old_ss, &ss);
+    free(ss.ss_sp);
+}
+
+/*
+ * Call a test case function (when fun is not NULL) or a procedure, 
+ * recovering from the signals it may raise. Return the number of the
+ * signal raised, or 0 if the call completed normally.
+ */
+static int nofork_call(void (*fun)(Status*), void (*proc)(void), Status *st)
+{
+    int sig;
+
+    sig = sigsetjmp(nofork_env, 1);
+    if (sig == 0)
+    {
+        nofork_active = 1;
+        if (fun != NULL)
+        {
+            __alloc_thread_reset();
+            fun(st);
+            __alloc_regions_check(st);
+        }
+        else
+        {
+            proc();
+        }
+    }
+    nofork_active = 0;
+
+    return sig;
+}
+
+/*
+ * Execute a test case inside the runner process.
+ */
+static void run_in_process(Suite *s, Test_case *tc, Result *res, long timeout)
+{
+    Status st = {};
+    struct itimerval timer = {};
+    struct rusage ru;
+    Metrics base;
+    long start = now_us();
+    int track = __track_alloc();
+    int perf = __perf_enabled();
+    int sig;
+
+    getrusage(RUSAGE_SELF, &ru);
+    get_metrics(&base, &ru);
+    base.max_rss = 0;
+    __peak_rss_reset();
+    if (track)
+        __alloc_start();
+
+    if (tc->timeout > 0)
+        timeout = tc->timeout;
+
+    timer.it_value.tv_sec = timeout / 1000;
+    timer.it_value.tv_usec = timeout % 1000 * 1000;
+    setitimer(ITIMER_REAL, &timer, NULL);
+
+    if (s->before != NULL && (sig = nofork_call(NULL, s->before, NULL)))
+    {
+        res->error = PHASE_BEFORE;
+    }
+    else
+    {
+        if (perf)
+            __perf_start();
+        if ((sig = nofork_call(tc->fun, NULL, &st)))
+            res->error = PHASE_TEST;
+        if (perf)
+            __perf_stop(&res->perf);
+    }
+
+    if (sig == SIGALRM && timeout > 0)
+        res->timeout = timeout;
+    else
+        res->term_sig = sig;
+
+    if (res->error != PHASE_BEFORE && s->after != NULL)
+    {
+        if (res->timeout) /* give AFTER_TEST its own time */
+            setitimer(ITIMER_REAL, &timer, NULL);
+
+        sig = nofork_call(NULL, s->after, NULL);
+        if (sig == SIGALRM && timeout > 0)
+            res->cleanup_timeout = timeout;
+        else
+            res->cleanup_sig = sig;
+    }
+
+    memset(&timer, 0, sizeof (timer));
+    setitimer(ITIMER_REAL, &timer, NULL);
+
+    if (track)
+        __alloc_stop(&res->alloc);
+
+    if (!res->error) /* copied out of the tracked allocations */
+        collect_status(res, &st, st.assertion, st.file);
+
+    /* the peak of the runner process covers its whole run */
+    getrusage(RUSAGE_SELF, &ru);
+    get_metrics(&res->m, &ru);
+    res->m.max_rss = __peak_rss();
+    add_metrics(&res->m, &base, -1);
+    res->m.wall_us = now_us() - start;
+
+    finish_result(res);
+}
+
+/*
+ * Move the test cases which failed in the previous run before the others,
+ * keeping the suite order inside both groups, and return their number.
+ */
+static int prioritize_failed(Runner *r, int tot)
+{
+    Test_case **rest;
+    Cache_entry *e;
+    int nf = 0;
+    int nr = 0;
+    int i;
+
+    rest = (Test_case**) malloc(tot * sizeof (Test_case*));
+    if (rest == NULL)
+    {
+        perror("suite_run: malloc error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (i = 0; i < tot; i++)
+    {
+        e = __cache_find(r->s->name, r->tcs[i]->name, 0);
+        if (e != NULL && e->failed)
+            r->tcs[nf++] = r->tcs[i];
+        else
+            rest[nr++] = r->tcs[i];
+    }
+    memcpy(r->tcs + nf, rest, nr * sizeof (Test_case*));
+
+    free(rest);
+    return nf;
+}
+
+/*
+ * Choose the order in which the selected test cases are started. With
+ * parallel jobs, the longest test cases, according to the durations of
+ * the previous runs, are started first, so that they do not extend the
+ * run when the other jobs are idle. The first nf test cases, which failed
+ * in the previous run, are all started before the others. Otherwise the 
+ * suite order is kept.
+ */
+static void schedule(Runner *r, int tot, int nf)
+{
+    long *est;
+    int i;
+
+    if (r->jobs < 2 || r->mode == SUITE_NOFORK)
+    {
+        for (i = 0; i < tot; i++)
+            r->order[i] = i;
+        return;
+    }
+
+    est = (long*) malloc(tot * sizeof (long));
+    if (est == NULL)
+    {
+        perror("suite_run: malloc error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    __cache_estimate(r->s->name, r->tcs, tot, est);
+    __sort_by_duration(est, nf, r->order);
+    __sort_by_duration(est + nf, tot - nf, r->order + nf);
+    for (i = nf; i < tot; i++)
+        r->order[i] += nf;
+
+    free(est);
+}
+
+/*
+ * Cancel the test cases not completed yet, once the maximum number of
+ * failures has been reached. Children running a test case are killed,
+ * while an AFTER_TEST procedure running after a lost test case is left
+ * to complete.
+ */
+static void cancel_tests(Runner *r, int next, int tot)
+{
+    Slot *sl;
+    int i;
+
+    r->cancelled = 1;
+
+    for (i = 0; i < r->jobs; i++)
+    {
+        sl = &r->slots[i];
+        if (sl->res == NULL || sl->cleanup)
+            continue;
+
+        kill(sl->pid, SIGKILL);
+        close(sl->fd);
+        if (sl->cmd >= 0)
+            close(sl->cmd);
+        while (waitpid(sl->pid, NULL, 0) == -1 && errno == EINTR)
+            ;
+        sl->pid = 0;
+
+        sl->res->cancelled = 1;
+        sl->res->done = 1;
+        sl->res = NULL;
+    }
+
+    for (; next < tot; next++)
+    {
+        r->results[r->order[next]].cancelled = 1;
+        r->results[r->order[next]].done = 1;
+    }
+}
+
+/*
+ * Record the durations and the outcomes of the executed test cases in the
+ * cache, when it is enabled or needed to schedule parallel jobs.
+ */
+static void record_results(Runner *r, int tot)
+{
+    Cache_entry *e;
+    int i;
+
+    if (r->jobs < 2 && !__cache_wanted())
+        return;
+
+    for (i = 0; i < tot; i++)
+    {
+        if (r->results[i].cancelled)
+            continue;
+
+        e = __cache_find(r->s->name, r->tcs[i]->name, 1);
+        if (e == NULL)
+            continue;
+
+        e->wall_us = r->results[i].m.wall_us;
+        e->failed = __result_outcome(&r->results[i]) != OUTCOME_SUCCESS;
+    }
+
+    __cache_save();
+}
+
+/*
+ * Start the fixture process, which executes the BEFORE_ALL procedure of
+ * the suite, and wait for the procedure to complete. The runner becomes
+ * the subreaper of its descendants, to collect the children forked by the
+ * fixture. Return zero, storing the termination status of the fixture
+ * process, if it terminated before completing the procedure.
+ */
+static int start_fixture(Runner *r, int *status)
 {
-    *s = (Suite*) malloc(sizeof (Suite));
+    int sv[2];
+    char ready;
 
-    if (*s == NULL)
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv))
     {
-        perror("suite_new: malloc error.\n");
+        perror("suite_run: socketpair error.\n");
         exit(EXIT_FAILURE);
     }
 
-    ll_init(&(*s)->asserts);
-    strncpy((*s)->name, name, NAME_LEN);
-    (*s)->before = bef;
-    (*s)->after = aft;
+    if (prctl(PR_GET_CHILD_SUBREAPER, &r->subreaper)
+            || prctl(PR_SET_CHILD_SUBREAPER, 1))
+    {
+        perror("suite_run: prctl error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    fflush(NULL); /* do not duplicate pending output in the child */
+
+    r->fixture_pid = fork();
+    switch (r->fixture_pid)
+    {
+        case -1:
+            perror("suite_run: fork error.\n");
+            exit(EXIT_FAILURE);
+
+        case 0: /* fixture process */
+            close(sv[0]);
+            run_fixture(r, sv[1]);
+    }
+
+    close(sv[1]);
+    r->fixture = sv[0];
+    if (read(r->fixture, &ready, 1) == 1)
+        return 1;
+
+    close(r->fixture);
+    r->fixture = -1;
+    while (waitpid(r->fixture_pid, status, 0) == -1 && errno == EINTR)
+        ;
+    r->fixture_pid = 0;
+    prctl(PR_SET_CHILD_SUBREAPER, r->subreaper);
 
     return 0;
 }
 
-/*!
- * Add the test case to the suite, labelling the test with the provided
- * name.
+/*
+ * Execute the BEFORE_ALL procedure of the suite, in the runner process in
+ * SUITE_NOFORK mode, or in the fixture process otherwise. When the 
+ * procedure fails, all the test cases are completed with an error. Return
+ * nonzero if the procedure completed.
  */
-int suite_add(Suite *s, void (*t)(Status*), const char *name)
+static int before_all(Runner *r, int tot)
 {
-    Test_case *tc = (Test_case*) malloc(sizeof (Test_case));
+    int status;
+    int sig = 0;
+    int code = 0;
+    int i;
 
-    if (tc == NULL)
+    if (r->mode == SUITE_NOFORK)
     {
-        perror("suite_add: malloc error.\n");
-        exit(EXIT_FAILURE);
+        if (r->s->before_all == NULL 
+                || !(sig = nofork_call(NULL, r->s->before_all, NULL)))
+            return 1;
+    }
+    else if (start_fixture(r, &status))
+    {
+        return 1;
+    }
+    else if (WIFSIGNALED(status)) /* fixture process signaled */
+    {
+        sig = WTERMSIG(status);
+    }
+    else /* fixture process exited, possibly with a failure status */
+    {
+        code = WEXITSTATUS(status);
     }
 
-    tc->fun = t;
-    strncpy(tc->name, name, NAME_LEN);
-
-    ll_push_front(&s->asserts, (void*) tc);
+    for (i = 0; i < tot; i++)
+    {
+        r->results[i].error = PHASE_BEFORE_ALL;
+        r->results[i].term_sig = sig;
+        r->results[i].exit_status = code;
+        finish_result(&r->results[i]);
+    }
 
     return 0;
 }
 
+/*
+ * Execute the AFTER_ALL procedure of the suite, in the runner process in
+ * SUITE_NOFORK mode, or in the fixture process otherwise, and record its
+ * outcome. The fixture process runs the procedure and terminates when
+ * its socket is closed.
+ */
+static void after_all(Runner *r, Summary *sum)
+{
+    int status;
+
+    if (r->mode == SUITE_NOFORK)
+    {
+        if (r->s->after_all != NULL)
+            sum->after_all_sig = nofork_call(NULL, r->s->after_all, NULL);
+        return;
+    }
+
+    close(r->fixture);
+    while (waitpid(r->fixture_pid, &status, 0) == -1 && errno == EINTR)
+        ;
+    r->fixture = -1;
+    r->fixture_pid = 0;
+    prctl(PR_SET_CHILD_SUBREAPER, r->subreaper);
+
+    if (WIFSIGNALED(status)) /* fixture process signaled */
+        sum->after_all_sig = WTERMSIG(status);
+    else /* fixture process exited, possibly with a failure status */
+        sum->after_all_status = WEXITSTATUS(status);
+}
+
 /*!
  * Run a suite of test cases. Test cases are executed sequentially, following
  * the order used to add them to the suite. Each test case runs in a separate
  * process. Before each test case, the statements defined with
  * the BEFORE_TEST(name) are executed, then the test runs, and after 
  * test termination the statements defined inside the AFTER_TEST(name) 
- * are executed.
+ * are executed, all of them inside the same process. If the test case
+ * process is lost, the AFTER_TEST(name) runs in a process of its own.
  */
 int suite_run(Suite *s)
 {
-    Test_case *tc;
-    Status st = {};
-    ll_iterator it = ll_get_iterator(s->asserts);
-    pid_t pid;
+    return suite_run_parallel(s, 1);
+}
+
+/*!
+ * Run a suite of test cases, keeping up to <code>jobs</code> test cases
+ * in execution at the same time. Test cases are started following the
+ * order used to add them to the suite, and their results are collected
+ * as soon as they terminate, but messages and summary are printed in
+ * the suite order, so that the output does not depend on the number of
+ * jobs.
+ */
+int suite_run_parallel(Suite *s, int jobs)
+{
+    Runner r;
+    Slot **busy;
+    struct pollfd *fds;
     int i;
-    int res;
-    int successes = 0;
-    int fails = 0;
-    int errors = 0;
-    int tot = s->asserts.size;
-    int char_num;
-    int fd[2];
-    int status;
-    int term_sig;
-    int exit_status;
+    int n;
+    int k;
+    int next = 0;      /* next test case to be started, in start order */
+    int reported = 0;  /* next test case to be reported */
+    int tot;
+    int fixture;       /* nonzero when BEFORE_ALL completed */
+    int max_failures = __max_failures();
+    long start = now_us();
+    Summary sum = {};
+    struct sigaction old_sa[sizeof (nofork_signals) / sizeof (int)];
+    stack_t old_ss;
+    void (*old_pipe)(int);
 
-    res = pipe(fd);
-    if (res)
+    r.tcs = (Test_case**) malloc(s->tests_len * sizeof (Test_case*));
+    if (s->tests_len > 0 && r.tcs == NULL)
     {
-        perror("suite_run: pipe error.\n");
+        perror("suite_run: malloc error.\n");
         exit(EXIT_FAILURE);
     }
 
-    printf("** Starting suite \"%s\" **\n", s->name);
+    tot = __suite_select(s, r.tcs);
+    sum.skipped = s->tests_len - tot;
 
-    if (s->asserts.size < 1) /* empty suite */
+    __report_start(s, tot);
+    if (__perf_enabled())
+        __perf_notice();
+
+    if (tot < 1) /* empty suite, or no test case selected */
     {
-        printf("  Suite \"%s\" does not contain any test case.\n", s->name);
-        return 0;
+        __report_end(s, &sum);
+        free(r.tcs);
+        if (max_failures > 0 && failures_total >= max_failures)
+            return 0; /* the run was stopped, benchmarks are skipped */
+        return __suite_run_benchmarks(s);
     }
 
-    for (i = 0; i < tot; i++)
+    r.s = s;
+    r.mode = get_mode(s);
+    r.timeout = get_timeout(s);
+    r.jobs = get_jobs(jobs);
+    if (r.jobs > tot)
+        r.jobs = tot;
+
+    r.results = (Result*) calloc(tot, sizeof (Result));
+    r.order = (int*) malloc(tot * sizeof (int));
+    r.slots = (Slot*) calloc(r.jobs, sizeof (Slot));
+    r.chans = (Channel*) mmap(
+            NULL,
+            r.jobs * sizeof (Channel),
+            PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_ANONYMOUS,
+            -1,
+            0);
+    busy = (Slot**) malloc(r.jobs * sizeof (Slot*));
+    fds = (struct pollfd*) malloc(r.jobs * sizeof (struct pollfd));
+    if (r.results == NULL || r.order == NULL || r.slots == NULL
+            || busy == NULL || fds == NULL)
     {
-        st.failed = 0;
-        tc = (Test_case*) ll_next(&it);
+        perror("suite_run: malloc error.\n");
+        exit(EXIT_FAILURE);
+    }
 
-        /* run BEFORE_TEST procedure if present */
-        if (s->before != NULL)
-        {
-            pid = fork();
-            switch (pid)
-            {
-                case -1:
-                    perror("suite_run: fork error.\n");
-                    exit(EXIT_FAILURE);
+    if (r.chans == MAP_FAILED)
+    {
+        perror("suite_run: mmap error.\n");
+        exit(EXIT_FAILURE);
+    }
 
-                case 0: /* child: exec BEFORE_TEST procedure and exit */
-                    s->before();
-                    exit(0);
+    for (i = 0; i < r.jobs; i++)
+    {
+        r.slots[i].cmd = -1;
+        r.slots[i].chan = &r.chans[i];
+    }
 
-                default: /* parent: wait for child termination */
-                    waitpid(pid, &status, 0);
-            }
+    r.cancelled = 0;
+    r.fixture = -1;
+    r.fixture_pid = 0;
+    schedule(&r, tot, __failed_first() ? prioritize_failed(&r, tot) : 0);
 
-            if(WIFSIGNALED(status)) /* child process signaled */
-            {
-                errors++;
-                term_sig = WTERMSIG(status);
-                printf( "Suite \"%s\", test case \"%s\", error:\n"
-                        "  BEFORE_TEST procedure terminated by signal %d. "
-                        "  Test case execution aborted.\n\n",
-                        s->name,
-                        tc->name,
-                        term_sig);
-                continue;
-            }
+    if (r.mode == SUITE_NOFORK)
+        nofork_setup(old_sa, &old_ss);
 
-            if (!WIFEXITED(status)) /* child process did not quit normally */
-            {
-                errors++;
-                exit_status = WEXITSTATUS(status);
-                printf( "Suite \"%s\", test case \"%s\", error:\n"
-                        "  BEFORE_TEST procedure failed with status %d."
-                        "  Test case execution aborted.\n\n",
-                        s->name,
-                        tc->name,
-                        exit_status);
-                continue;
-            }
+    /* set up the state inherited by all the test cases */
+    fixture = s->before_all != NULL || s->after_all != NULL;
+    if (fixture && !(fixture = before_all(&r, tot)))
+        next = tot;
+
+    old_pipe = signal(SIGPIPE, SIG_IGN); /* workers may be lost */
+
+    while (reported < tot)
+    {
+        /* stop when too many test cases failed */
+        if (!r.cancelled && max_failures > 0 
+                && failures_total >= max_failures)
+        {
+            cancel_tests(&r, next, tot);
+            next = tot;
         }
 
-        /* run current test case */
-        pid = fork();
-        switch (pid)
+        /* start pending test cases, as long as there are free slots */
+        while (next < tot)
         {
-            case -1:
-                perror("suite_run: fork error.\n");
-                exit(EXIT_FAILURE);
+            k = r.order[next];
+            if (r.mode == SUITE_NOFORK && !(r.tcs[k]->flags & TEST_FORK))
+            {
+                run_in_process(s, r.tcs[k], &r.results[k], r.timeout);
+                next++;
+                break;
+            }
 
-            case 0: /* child: exec test, write result and exit */
-                tc->fun(&st); /* run test case function */
-                write(fd[1], &st, sizeof (Status)); /* write result */
-                exit(0);
+            for (i = 0; i < r.jobs && r.slots[i].res != NULL; i++)
+                ;
+            if (i == r.jobs) /* no free slots */
+                break;
 
-            default: /* parent: wait for child termination */
-                waitpid(pid, &status, 0);
+            start_test(&r, &r.slots[i], k);
+            next++;
         }
 
-        if(WIFSIGNALED(status)) /* child process signaled */
+        /* wait for any busy slot to be ready */
+        for (i = 0, n = 0; i < r.jobs; i++)
         {
-            errors++;
-            term_sig = WTERMSIG(status);
-            printf( "Suite \"%s\", test case \"%s\", error:\n"
-                    "  test terminated by signal %d.\n\n",
-                    s->name,
-                    tc->name,
-                    term_sig);
-            continue;
+            if (r.slots[i].res == NULL)
+                continue;
+            fds[n].fd = r.slots[i].fd;
+            fds[n].events = POLLIN;
+            busy[n++] = &r.slots[i];
         }
 
-        if (!WIFEXITED(status)) /* child process did not terminate normally */
+        if (n > 0 && poll(fds, n, check_deadlines(&r)) == -1)
         {
-            errors++;
-            exit_status = WEXITSTATUS(status);
-            printf( "Suite \"%s\", test case \"%s\", error:\n"
-                    "  test failed with status %d.\n\n",
-                    s->name,
-                    tc->name,
-                    exit_status);
-            continue;
+            if (errno == EINTR)
+                continue;
+            perror("suite_run: poll error.\n");
+            exit(EXIT_FAILURE);
         }
 
-        /* run AFTER_TEST procedure if present */
-        if (s->after != NULL)
-        {
-            pid = fork();
-            switch (pid)
-            {
-                case -1:
-                    perror("suite_run: fork error.\n");
-                    exit(EXIT_FAILURE);
-
-                case 0: /* child: exec AFTER_TEST procedure and exit */
-                    s->after();
-                    exit(0);
+        for (i = 0; i < n; i++)
+            if (fds[i].revents)
+                read_slot(&r, busy[i]);
 
-                default: /* parent: wait for child termination */
-                    waitpid(pid, &status, 0);
-            }
+        check_deadlines(&r);
 
-            if(WIFSIGNALED(status)) /* child process signaled */
+        /* print results in suite order, as soon as they are available */
+        while (reported < tot && r.results[reported].done)
+        {
+            if (r.results[reported].cancelled)
             {
-                term_sig = WTERMSIG(status);
-                printf( "Suite \"%s\", test case \"%s\", error on cleanup:\n"
-                        "  AFTER_TEST procedure terminated by signal %d.\n\n",
-                        s->name,
-                        tc->name,
-                        term_sig);
+                sum.cancelled++;
+                reported++;
+                continue;
             }
 
-            else if (!WIFEXITED(status)) /* child did not quit normally */
+            switch (__result_outcome(&r.results[reported]))
             {
-                exit_status = WEXITSTATUS(status);
-                printf( "Suite \"%s\", test case \"%s\", error on cleanup:\n"
-                        "  AFTER_TEST procedure failed with status %d.\n\n",
-                        s->name,
-                        tc->name,
-                        exit_status);
+                case OUTCOME_SUCCESS: sum.successes++; break;
+                case OUTCOME_FAILURE: sum.failures++; break;
+                case OUTCOME_ERROR: sum.errors++; break;
             }
+            __report_result(s, r.tcs[reported], &r.results[reported]);
+            reported++;
         }
+    }
 
-        /* test execution complete, read result */
-        read(fd[0], &st, sizeof (Status));
+    for (i = 0; i < r.jobs; i++)
+        stop_worker(&r.slots[i]);
 
-        if (st.failed) /* write message if test failed */
-        {
-            fails++;
-            printf( "Suite \"%s\", test case \"%s\", assertion failure:\n"
-                    "  %s\n\n",
-                    s->name,
-                    tc->name,
-                    st.assertion);
-        }
-        
-        if (st.invalid) /* write message if test was invalid */
-        {
-            errors++;
-            printf( "Suite \"%s\", test case \"%s\", invalid assertion:\n"
-                    "  %s\n"
-                    "  %s\n\n",
-                    s->name,
-                    tc->name,
-                    st.assertion,
-                    st.invalid);
-        }
+    if (fixture)
+        after_all(&r, &sum);
+
+    signal(SIGPIPE, old_pipe);
+
+    if (r.mode == SUITE_NOFORK)
+        nofork_cleanup(old_sa, &old_ss);
+
+    munmap(r.chans, r.jobs * sizeof (Channel));
+    free(r.slots);
+    free(fds);
+    free(busy);
+
+    record_results(&r, tot);
+
+    sum.tests = tot - sum.cancelled;
+    sum.wall_us = now_us() - start;
+    sum.tcs = r.tcs;
+    sum.results = r.results;
+    __report_end(s, &sum);
+
+    for (i = 0; i < tot; i++)
+    {
+        free(r.results[i].assertion);
+        free(r.results[i].file);
+        free(r.results[i].message);
     }
 
-    /* print suite summary */
-    successes = tot - fails - errors;
-    char_num = (successes == tot || fails == tot || errors == tot ? 6 : 5);
-    printf("\nSuite \"%s\" execution complete:\n"
-            " %d success%2s (%*.2f%%)\n"
-            " %d failure%s  (%*.2f%%)\n"
-            " %d error%s    (%*.2f%%)\n",
-            s->name,
-            successes,
-            successes == 1 ? "  " : "es",
-            char_num,
-            (float) successes / tot * 100,
-            fails,
-            fails == 1 ? " " : "s",
-            char_num,
-            (float) fails / tot * 100,
-            errors,
-            errors == 1 ? " " : "s",
-            char_num,
-            (float) errors / tot * 100);
+    free(r.tcs);
+    free(r.order);
+    free(r.results);
 
-    return 0;
+    if (r.cancelled) /* the run was stopped, benchmarks are skipped */
+        return 0;
+
+    return __suite_run_benchmarks(s);
+}
+
+/*
+ * Compare two test case descriptors by source file and line, for qsort().
+ */
+static int cmp_desc(const void *a, const void *b)
+{
+    const Test_case *x = (const Test_case*) a;
+    const Test_case *y = (const Test_case*) b;
+    int c = strcmp(x->file, y->file);
+
+    return c ? c : (x->line > y->line) - (x->line < y->line);
+}
+
+/*!
+ * Run all the test cases registered automatically. The descriptors are
+ * sorted in place by source file and line, since the linker does not 
+ * guarantee their order, and each source file is run as a suite, named
+ * after the file, directly on its slice of the section. Return 1 if any
+ * test case failed or terminated with an error, 0 otherwise.
+ */
+int cutest_run_all(void)
+{
+    Test_case *first = __start_cutest_tests;
+    Test_case *last = __stop_cutest_tests;
+    Test_case *next;
+    Suite s;
+
+    if (first == last)
+    {
+        printf("No test cases registered.\n");
+        return 0;
+    }
+
+    qsort(first, last - first, sizeof (Test_case), cmp_desc);
+
+    for (; first < last; first = next)
+    {
+        for (next = first; next < last; next++)
+            if (strcmp(next->file, first->file))
+                break;
+
+        memset(&s, 0, sizeof (Suite));
+        snprintf(s.name, NAME_LEN, "%s", first->file);
+        ll_init(&s.benchmarks);
+        s.mode = SUITE_FORK;
+        s.tests = first;
+        s.tests_len = next - first;
+
+        suite_run(&s);
+        if (next < last)
+            printf("\n");
+    }
+
+    return failures_total != 0;
 }
 
 /*!
@@ -309,13 +1728,15 @@ int __assert_equals_flo(double x, double y, double tol, Status *__s)
 {
     if (tol <= 0.0)
     { 
-        sprintf((char *) __s->invalid,
+        snprintf(__s->message, MSG_LEN,
                 "Invalid \"tol\" value (%.6e). \"Tol\" must be positive",
                 tol);
+        __s->failed = 1;
+        __s->invalid = 1;
         return 0;
     }
     __s->failed = !(fabs((x) - (y)) < (tol));
-    __s->invalid = NULL;
+    __s->invalid = 0;
     return 0;
 }
 
@@ -325,23 +1746,29 @@ int __assert_equals_flo(double x, double y, double tol, Status *__s)
 int __assert_equals_array_int(
         int *x,
         int *y,
-        int len,
+        size_t len,
         Status *__s)
 {
-    int i;
+    size_t i;
 
-    if (len < 1)
+    if ((ptrdiff_t) len < 1)
     {
-        sprintf((char *) __s->invalid,
-                "Invalid array length (%d). Length must be > 0.\n", len);
+        snprintf(__s->message, MSG_LEN,
+                "Invalid array length (%td). Length must be > 0.",
+                (ptrdiff_t) len);
+        __s->failed = 1;
+        __s->invalid = 1;
         return 0;
     }
 
-    __s->failed = 0;
-    for (i = 0; i < len; ++i)
-        __s->failed |= (x[i] != y[i]);
+    i = __compare_int(x, y, len);
+    __s->failed = i < len;
+    __s->invalid = 0;
 
-    __s->invalid = NULL;
+    if (__s->failed)
+        snprintf(__s->message, MSG_LEN,
+                "First mismatch at index %zu: %d != %d.",
+                i, x[i], y[i]);
 
     return 0;
 }
@@ -353,82 +1780,402 @@ int __assert_equals_array_int(
 int __assert_equals_array_flo(
         double *x,
         double *y,
-        int len, 
+        size_t len, 
         double tol,
         Status *__s)
 {
-    int i;
+    size_t i;
 
-    if (len < 1)
+    if ((ptrdiff_t) len < 1)
     {
-        sprintf((char *) __s->invalid,
-                "Invalid array length (%d). Length must be > 0.\n", len);
+        snprintf(__s->message, MSG_LEN,
+                "Invalid array length (%td). Length must be > 0.",
+                (ptrdiff_t) len);
+        __s->failed = 1;
+        __s->invalid = 1;
         return 0;
     }
 
-    __s->failed = 0;
-    for (i = 0; i < len; ++i)
-        __s->failed |= fabs(x[i] - y[i]) > tol;
+    i = __compare_flo(x, y, len, tol);
+    __s->failed = i < len;
+    __s->invalid = 0;
 
-    __s->invalid = NULL;
+    if (__s->failed)
+        snprintf(__s->message, MSG_LEN,
+                "First mismatch at index %zu: %.17g != %.17g "
+                "(tolerance %g).",
+                i, x[i], y[i], tol);
 
     return 0;
 }
 
 /*!
- * This function actually implements floating point matrix
- * equality assertion.
+ * This function actually implements int matrix equality assertion.
+ * The rows of the matrixes are contiguous, so they are compared as
+ * arrays of m * n entries.
  */
 int __assert_equals_matrix_int(
-        int m,
-        int n,
+        size_t m,
+        size_t n,
         int x[m][n],
         int y[m][n],
         Status *__s)
 {
-    int i, j;
+    size_t i;
 
-    if (n < 1 || m < 1)
+    if ((ptrdiff_t) n < 1 || (ptrdiff_t) m < 1)
     {
-        sprintf((char *) __s->invalid,
-                "Invalid matrix size. Dimension must be > 0.\n");
+        snprintf(__s->message, MSG_LEN,
+                "Invalid matrix size. Dimension must be > 0.");
+        __s->failed = 1;
+        __s->invalid = 1;
         return 0;
     }
 
-    for (i = 0; i < m; ++i)
-        for (j = 0; j < n; ++j)
-            __s->failed |= (x[i][j] != y[i][j]);
+    i = __compare_int(&x[0][0], &y[0][0], m * n);
+    __s->failed = i < m * n;
+    __s->invalid = 0;
 
-    __s->invalid = NULL;
+    if (__s->failed)
+        snprintf(__s->message, MSG_LEN,
+                "First mismatch at [%zu][%zu]: %d != %d.",
+                i / n, i % n, x[i / n][i % n], y[i / n][i % n]);
 
     return 0;
 }
         
 /*!
- * This function actually implements int matrix equality assertion.
+ * This function actually implements floating point matrix
+ * equality assertion. The rows of the matrixes are contiguous, so they
+ * are compared as arrays of m * n entries.
  */
 int __assert_equals_matrix_flo(
-        int m, 
-        int n,
+        size_t m, 
+        size_t n,
         double x[m][n],
         double y[m][n],
         double tol,
         Status *__s)
 {
-    int i, j;
+    size_t i;
+
+    if ((ptrdiff_t) n < 1 || (ptrdiff_t) m < 1)
+    {
+        snprintf(__s->message, MSG_LEN,
+                "Invalid matrix size. Dimension must be > 0.");
+        __s->failed = 1;
+        __s->invalid = 1;
+        return 0;
+    }
+
+    i = __compare_flo(&x[0][0], &y[0][0], m * n, tol);
+    __s->failed = i < m * n;
+    __s->invalid = 0;
+
+    if (__s->failed)
+        snprintf(__s->message, MSG_LEN,
+                "First mismatch at [%zu][%zu]: %.17g != %.17g "
+                "(tolerance %g).",
+                i / n, i % n, x[i / n][i % n], y[i / n][i % n], tol);
+
+    return 0;
+}
+
+/*
+ * Check the size of the values compared by a tolerance assertion, marking
+ * the assertion as invalid if it is not positive.
+ */
+static int check_size(size_t m, size_t n, int shape, Status *__s)
+{
+    if ((ptrdiff_t) m >= 1 && (ptrdiff_t) n >= 1)
+        return 1;
+
+    if (shape == SHAPE_MATRIX)
+        snprintf(__s->message, MSG_LEN,
+                "Invalid matrix size. Dimension must be > 0.");
+    else
+        snprintf(__s->message, MSG_LEN,
+                "Invalid array length (%td). Length must be > 0.",
+                (ptrdiff_t) m);
+    __s->failed = 1;
+    __s->invalid = 1;
+    return 0;
+}
+
+/*
+ * Check the tolerances of a relative assertion, marking the assertion as
+ * invalid if they are negative or both zero.
+ */
+static int check_tolerances(double abs, double rel, Status *__s)
+{
+    if (abs >= 0.0 && rel >= 0.0 && (abs > 0.0 || rel > 0.0))
+        return 1;
+
+    snprintf(__s->message, MSG_LEN,
+            "Invalid tolerances (abs %.6e, rel %.6e). Tolerances must be "
+            "non negative, and not both zero.",
+            abs, rel);
+    __s->failed = 1;
+    __s->invalid = 1;
+    return 0;
+}
+
+/*
+ * Check the tolerance of an ulp assertion, marking the assertion as
+ * invalid if it is negative.
+ */
+static int check_ulps(long ulps, Status *__s)
+{
+    if (ulps >= 0)
+        return 1;
+
+    snprintf(__s->message, MSG_LEN,
+            "Invalid \"ulps\" value (%ld). \"Ulps\" must be >= 0.", ulps);
+    __s->failed = 1;
+    __s->invalid = 1;
+    return 0;
+}
+
+/*
+ * Write in the status message the worst entry out of tolerance, with its
+ * position, the number of entries out of tolerance and the error.
+ */
+static void describe_mismatch(
+        Status *__s,
+        size_t m,
+        size_t n,
+        int shape,
+        const Mismatch *mm,
+        int digits,
+        double x,
+        double y,
+        const char *error)
+{
+    char pos[96] = "";
+
+    if (shape == SHAPE_ARRAY)
+        snprintf(pos, sizeof (pos),
+                "%zu of %zu entries out of tolerance, worst at index %zu: ",
+                mm->count, m, mm->worst);
+    else if (shape == SHAPE_MATRIX)
+        snprintf(pos, sizeof (pos),
+                "%zu of %zu entries out of tolerance, worst at [%zu][%zu]: ",
+                mm->count, m * n, mm->worst / n, mm->worst % n);
+
+    snprintf(__s->message, MSG_LEN, "%s%.*g != %.*g (%s).",
+            pos, digits, x, digits, y, error);
+}
+
+/*
+ * Describe the error of two values out of an absolute and relative 
+ * tolerance.
+ */
+static void close_error(
+        char *buf,
+        size_t len,
+        double x,
+        double y,
+        double abs,
+        double rel)
+{
+    snprintf(buf, len,
+            "absolute error %.3g, relative error %.3g, "
+            "tolerance abs %g rel %g",
+            fabs(x - y), fabs(x - y) / fmax(fabs(x), fabs(y)), abs, rel);
+}
+
+/*!
+ * This function actually implements the equality assertions on doubles
+ * with a tolerance in units in the last place.
+ */
+int __assert_ulp_dbl(
+        const double *x,
+        const double *y,
+        size_t m,
+        size_t n,
+        int shape,
+        long ulps,
+        Status *__s)
+{
+    Mismatch mm;
+    char err[64];
+
+    if (!check_size(m, n, shape, __s) || !check_ulps(ulps, __s))
+        return 0;
+
+    __s->failed = __compare_ulp_dbl(x, y, m * n, ulps, &mm) > 0;
+    __s->invalid = 0;
+
+    if (__s->failed)
+    {
+        snprintf(err, sizeof (err), "%.0f ulp, tolerance %ld ulp",
+                mm.error, ulps);
+        describe_mismatch(__s, m, n, shape, &mm, 17,
+                x[mm.worst], y[mm.worst], err);
+    }
+
+    return 0;
+}
+
+/*!
+ * This function actually implements the equality assertions on floats
+ * with a tolerance in units in the last place.
+ */
+int __assert_ulp_flt(
+        const float *x,
+        const float *y,
+        size_t m,
+        size_t n,
+        int shape,
+        long ulps,
+        Status *__s)
+{
+    Mismatch mm;
+    char err[64];
+
+    if (!check_size(m, n, shape, __s) || !check_ulps(ulps, __s))
+        return 0;
+
+    __s->failed = __compare_ulp_flt(x, y, m * n, ulps, &mm) > 0;
+    __s->invalid = 0;
+
+    if (__s->failed)
+    {
+        snprintf(err, sizeof (err), "%.0f ulp, tolerance %ld ulp",
+                mm.error, ulps);
+        describe_mismatch(__s, m, n, shape, &mm, 9,
+                x[mm.worst], y[mm.worst], err);
+    }
+
+    return 0;
+}
+
+/*!
+ * This function actually implements the equality assertions on doubles
+ * with an absolute and a relative tolerance.
+ */
+int __assert_close_dbl(
+        const double *x,
+        const double *y,
+        size_t m,
+        size_t n,
+        int shape,
+        double abs,
+        double rel,
+        Status *__s)
+{
+    Mismatch mm;
+    char err[128];
+
+    if (!check_size(m, n, shape, __s) || !check_tolerances(abs, rel, __s))
+        return 0;
+
+    __s->failed = __compare_close_dbl(x, y, m * n, abs, rel, &mm) > 0;
+    __s->invalid = 0;
+
+    if (__s->failed)
+    {
+        close_error(err, sizeof (err), x[mm.worst], y[mm.worst], abs, rel);
+        describe_mismatch(__s, m, n, shape, &mm, 17,
+                x[mm.worst], y[mm.worst], err);
+    }
+
+    return 0;
+}
+
+/*!
+ * This function actually implements the equality assertions on floats
+ * with an absolute and a relative tolerance.
+ */
+int __assert_close_flt(
+        const float *x,
+        const float *y,
+        size_t m,
+        size_t n,
+        int shape,
+        double abs,
+        double rel,
+        Status *__s)
+{
+    Mismatch mm;
+    char err[128];
+
+    if (!check_size(m, n, shape, __s) || !check_tolerances(abs, rel, __s))
+        return 0;
+
+    __s->failed = __compare_close_flt(x, y, m * n, abs, rel, &mm) > 0;
+    __s->invalid = 0;
+
+    if (__s->failed)
+    {
+        close_error(err, sizeof (err), x[mm.worst], y[mm.worst], abs, rel);
+        describe_mismatch(__s, m, n, shape, &mm, 9,
+                x[mm.worst], y[mm.worst], err);
+    }
+
+    return 0;
+}
+
+/*!
+ * This function actually implements the type generic equality assertions.
+ * Integers have a single representation, so integer arrays are compared
+ * as memory, whatever the size of their entries. Floating point arrays are
+ * compared with zero tolerances, which accept only equal entries.
+ */
+int __assert_equals_typed(
+        const void *x,
+        const void *y,
+        size_t m,
+        size_t n,
+        int shape,
+        int x_type,
+        int y_type,
+        Status *__s)
+{
+    const char *a = (const char*) x;
+    const char *b = (const char*) y;
+    char x_val[32];
+    char y_val[32];
+    size_t size;
+    size_t i;
+
+    if (!check_size(m, n, shape, __s))
+        return 0;
 
-    if (n < 1 || m < 1)
+    if (x_type != y_type)
     {
-        sprintf((char *) __s->invalid,
-                "Invalid matrix size. Dimension must be > 0.\n");
+        snprintf(__s->message, MSG_LEN,
+                "Invalid comparison between entries of different types.");
+        __s->failed = 1;
+        __s->invalid = 1;
         return 0;
     }
 
-    for (i = 0; i < m; ++i)
-        for (j = 0; j < n; ++j)
-            __s->failed |= fabs(x[i][j] - y[i][j]) > tol;
+    size = __type_size(x_type);
+
+    if (x_type == TYPE_FLOAT)
+        i = __compare_equal_flt(x, y, m * n);
+    else if (x_type == TYPE_DOUBLE)
+        i = __compare_equal_dbl(x, y, m * n);
+    else
+        i = __compare_bytes(x, y, m * n * size) / size;
+
+    __s->failed = i < m * n;
+    __s->invalid = 0;
+
+    if (!__s->failed)
+        return 0;
 
-    __s->invalid = NULL;
+    __format_entry(x_val, sizeof (x_val), a + i * size, x_type);
+    __format_entry(y_val, sizeof (y_val), b + i * size, y_type);
+    if (shape == SHAPE_MATRIX)
+        snprintf(__s->message, MSG_LEN,
+                "First mismatch at [%zu][%zu]: %s != %s.",
+                i / n, i % n, x_val, y_val);
+    else
+        snprintf(__s->message, MSG_LEN,
+                "First mismatch at index %zu: %s != %s.",
+                i, x_val, y_val);
 
     return 0;
 }
@@ -25,7 +25,9 @@
  */
 
 #include <math.h>
+#include <stdint.h>
 #include <string.h>
+#include <sys/types.h>
 #include "linked_list.h"
 #include "cutest_private.h"
 
@@ -49,7 +51,94 @@
  * If an assertion fails, the execution of the test case is interrupted 
  * and the test is considered as failed.
  */
-#define TEST_CASE(name) _TEST_CASE((name))
+#define TEST_CASE(name) _TEST_CASE(name)
+
+/*!
+ * \brief Flag for test cases which always run in a process of their own.
+ */
+#define TEST_FORK 1
+
+/*!
+ * \brief Declaration of a test case which always runs in its own process.
+ * @param name Name for the test case
+ *
+ * This macro works like TEST_CASE(name), but the test case is executed in
+ * a separate process even when its suite runs in SUITE_NOFORK mode. It is
+ * meant for test cases which may corrupt the runner state, or which call
+ * exit().
+ */
+#define TEST_CASE_FORK(name) _TEST_CASE_ATTR(name, TEST_FORK, 0)
+
+/*!
+ * \brief Declaration of a test case with a timeout.
+ * @param name Name for the test case
+ * @param ms Timeout in milliseconds
+ *
+ * This macro works like TEST_CASE(name), but the test case is interrupted
+ * and counted as failed with error if its execution (including the 
+ * BEFORE_TEST procedure) lasts more than <code>ms</code> milliseconds.
+ * This timeout has precedence over the one of the suite.
+ */
+#define TEST_CASE_TIMEOUT(name, ms) _TEST_CASE_ATTR(name, 0, (ms))
+
+/*!
+ * \brief Declaration of a benchmark.
+ * @param name Name for the benchmark
+ *
+ * A benchmark is declared with this macro, and its timed code is placed
+ * inside a BENCHMARK_LOOP, as:
+ * \code
+ * BENCHMARK(bench_name)
+ * {
+ *     // setup code, not timed
+ *
+ *     BENCHMARK_LOOP
+ *     {
+ *         // timed code
+ *     }
+ * }
+ * \endcode
+ *
+ * The runner calibrates the number of iterations of the loop so that each
+ * sample lasts at least <tt>CUTEST_BENCH_TIME</tt> milliseconds (50 by
+ * default), runs a warmup sample and then <tt>CUTEST_BENCH_SAMPLES</tt>
+ * samples (10 by default), and reports mean, median, standard deviation
+ * and minimum of the time per iteration. With <tt>--perf</tt>, the 
+ * hardware counters are read for the timed loop of each sample only, and
+ * their median and minimum per iteration are reported.
+ *
+ * If the benchmark does not contain a BENCHMARK_LOOP, the whole function
+ * is timed as a single iteration.
+ */
+#define BENCHMARK(name) _BENCHMARK((name))
+
+/*!
+ * \brief Timed loop of a benchmark.
+ *
+ * This macro works only inside a BENCHMARK(name) definition, and it must
+ * be used at most once. The statement or block following it is executed
+ * the number of times requested by the runner, and its execution time is
+ * measured.
+ */
+#define BENCHMARK_LOOP _BENCHMARK_LOOP
+
+/*!
+ * \brief Prevent the compiler from optimizing away a value.
+ *
+ * The compiler assumes that the value is read, so the computation 
+ * producing it cannot be removed from a benchmark.
+ *
+ * @param x Value to be preserved
+ */
+#define do_not_optimize(x) _do_not_optimize(x)
+
+/*!
+ * \brief Prevent the compiler from optimizing away memory writes.
+ *
+ * The compiler assumes that all memory is read and written, so pending
+ * writes cannot be removed or delayed past this point.
+ */
+#define clobber() _clobber()
 
 /*!
  * \brief Define a procedure to be executed before each test case.
@@ -65,6 +154,9 @@
  * test case, allowing to write once eventual initialization staments needed
  * by all the test cases. This must be done outside other subroutines.
  *
+ * The procedure runs in the same process of the test case, so any state
+ * it sets up (e.g. global variables) is visible from the test case code.
+ *
  * @param name Name for the procedure
  */
 #define BEFORE_TEST(name) _BEFORE_TEST((name))
@@ -90,6 +182,51 @@
  */
 #define AFTER_TEST(name) _AFTER_TEST((name))
 
+/*!
+ * \brief Define a procedure to be executed once before the test cases of
+ * a suite.
+ *
+ * \code
+ * BEFORE_ALL(name)
+ * {
+ *     // procedure code
+ * }
+ * \endcode
+ *
+ * The procedure runs once per suite run, in a fixture process, and each
+ * test case process is forked from the fixture after the procedure
+ * completed, so the state it sets up (e.g. data loaded in memory) is
+ * inherited by the test cases copy-on-write, without being rebuilt for
+ * each of them. Changes made by a test case are not seen by the others,
+ * except by the following test cases of the same worker in SUITE_WORKERS
+ * mode, and by all of them in SUITE_NOFORK mode.
+ *
+ * If the procedure terminates with an error, all the test cases of the
+ * suite fail with error. The procedure has no timeout.
+ *
+ * @param name Name for the procedure
+ */
+#define BEFORE_ALL(name) _BEFORE_ALL((name))
+
+/*!
+ * \brief Define a procedure to be executed once after the test cases of
+ * a suite.
+ *
+ * \code
+ * AFTER_ALL(name)
+ * {
+ *     // procedure code
+ * }
+ * \endcode
+ *
+ * The procedure runs in the fixture process, after all the test cases
+ * completed, and sees the state set up by the BEFORE_ALL(name) procedure.
+ * It is not executed when the BEFORE_ALL(name) procedure fails.
+ *
+ * @param name Name for the procedure
+ */
+#define AFTER_ALL(name) _AFTER_ALL((name))
+
 /*!
  * \brief Assert wether a condition is true.
  * @param expr Logical (integer) expression to be tested.
@@ -162,6 +299,8 @@
 /*!
  * \brief Assert two arrays have the same integer entries.
  *
+ * The failure message reports the first different entry.
+ *
  * @param x First array to be compared
  * @param y Second array to be comprared
  * @param len Array length
@@ -172,7 +311,9 @@
 
 /*!
  * \brief Assert two arrays have the same floating point entries.
- * 
+ *
+ * The failure message reports the first different entry.
+ *
  * @param x First array to be compared
  * @param y Second array to be comprared
  * @param len Array length
@@ -184,7 +325,9 @@
 
 /*!
  * \brief Assert two matrixes have the same integer entries.
- * 
+ *
+ * The failure message reports the first different entry.
+ *
  * @param x First matrix to be compared
  * @param y Second matrix to be comprared
  * @param m Number of rows in the matrix
@@ -196,7 +339,9 @@
 
 /*!
  * \brief Assert two matrixes have the same floating point entries.
- * 
+ *
+ * The failure message reports the first different entry.
+ *
  * @param x First matrix to be compared
  * @param y Second matrix to be comprared
  * @param m Number of rows in the matrix
@@ -207,6 +352,457 @@
 #define assert_equals_matrix_flo(x, y, m, n, tol, msg) \
     _assert_equals_matrix_flo(x, y, m, n, tol, msg)
 
+/*!
+ * \brief Assert two double numbers are equal, within a distance in units in
+ * the last place (ulp).
+ *
+ * @param x First number to be compared
+ * @param y Second number to be compared
+ * @param ulps Maximum distance in ulp (0 requires equal values)
+ * @param msg Human readable message, showed when assert fails
+ */
+#define assert_equals_ulp(x, y, ulps, msg) _assert_equals_ulp(x, y, ulps, msg)
+
+/*!
+ * \brief Assert two float numbers are equal, within a distance in units in
+ * the last place (ulp).
+ *
+ * @param x First number to be compared
+ * @param y Second number to be compared
+ * @param ulps Maximum distance in ulp (0 requires equal values)
+ * @param msg Human readable message, showed when assert fails
+ */
+#define assert_equals_ulp_float(x, y, ulps, msg) \
+    _assert_equals_ulp_float(x, y, ulps, msg)
+
+/*!
+ * \brief Assert two double numbers are equal, within a relative tolerance,
+ * scaled by the larger magnitude.
+ *
+ * @param x First number to be compared
+ * @param y Second number to be compared
+ * @param rel Relative tolerance
+ * @param msg Human readable message, showed when assert fails
+ */
+#define assert_equals_rel(x, y, rel, msg) _assert_equals_rel(x, y, rel, msg)
+
+/*!
+ * \brief Assert two float numbers are equal, within a relative tolerance,
+ * scaled by the larger magnitude.
+ *
+ * @param x First number to be compared
+ * @param y Second number to be compared
+ * @param rel Relative tolerance
+ * @param msg Human readable message, showed when assert fails
+ */
+#define assert_equals_rel_float(x, y, rel, msg) \
+    _assert_equals_rel_float(x, y, rel, msg)
+
+/*!
+ * \brief Assert two double numbers are equal, within an absolute or a
+ * relative tolerance.
+ *
+ * @param x First number to be compared
+ * @param y Second number to be compared
+ * @param abs Absolute tolerance
+ * @param rel Relative tolerance, scaled by the larger magnitude
+ * @param msg Human readable message, showed when assert fails
+ */
+#define assert_equals_close(x, y, abs, rel, msg) \
+    _assert_equals_close(x, y, abs, rel, msg)
+
+/*!
+ * \brief Assert two float numbers are equal, within an absolute or a
+ * relative tolerance.
+ *
+ * @param x First number to be compared
+ * @param y Second number to be compared
+ * @param abs Absolute tolerance
+ * @param rel Relative tolerance, scaled by the larger magnitude
+ * @param msg Human readable message, showed when assert fails
+ */
+#define assert_equals_close_float(x, y, abs, rel, msg) \
+    _assert_equals_close_float(x, y, abs, rel, msg)
+
+/*!
+ * \brief Assert two double arrays have equal entries, within a distance in
+ * units in the last place (ulp).
+ *
+ * The failure message reports the number of entries out of tolerance
+ * and the worst one.
+ *
+ * @param x First array to be compared
+ * @param y Second array to be compared
+ * @param len Array length
+ * @param ulps Maximum distance in ulp (0 requires equal values)
+ * @param msg Human readable message, showed when assert fails
+ */
+#define assert_equals_array_ulp(x, y, len, ulps, msg) \
+    _assert_equals_array_ulp(x, y, len, ulps, msg)
+
+/*!
+ * \brief Assert two float arrays have equal entries, within a distance in
+ * units in the last place (ulp).
+ *
+ * The failure message reports the number of entries out of tolerance
+ * and the worst one.
+ *
+ * @param x First array to be compared
+ * @param y Second array to be compared
+ * @param len Array length
+ * @param ulps Maximum distance in ulp (0 requires equal values)
+ * @param msg Human readable message, showed when assert fails
+ */
+#define assert_equals_array_ulp_float(x, y, len, ulps, msg) \
+    _assert_equals_array_ulp_float(x, y, len, ulps, msg)
+
+/*!
+ * \brief Assert two double arrays have equal entries, within a relative
+ * tolerance, scaled by the larger magnitude.
+ *
+ * The failure message reports the number of entries out of tolerance
+ * and the worst one.
+ *
+ * @param x First array to be compared
+ * @param y Second array to be compared
+ * @param len Array length
+ * @param rel Relative tolerance
+ * @param msg Human readable message, showed when assert fails
+ */
+#define assert_equals_array_rel(x, y, len, rel, msg) \
+    _assert_equals_array_rel(x, y, len, rel, msg)
+
+/*!
+ * \brief Assert two float arrays have equal entries, within a relative
+ * tolerance, scaled by the larger magnitude.
+ *
+ * The failure message reports the number of entries out of tolerance
+ * and the worst one.
+ *
+ * @param x First array to be compared
+ * @param y Second array to be compared
+ * @param len Array length
+ * @param rel Relative tolerance
+ * @param msg Human readable message, showed when assert fails
+ */
+#define assert_equals_array_rel_float(x, y, len, rel, msg) \
+    _assert_equals_array_rel_float(x, y, len, rel, msg)
+
+/*!
+ * \brief Assert two double arrays have equal entries, within an absolute or
+ * a relative tolerance.
+ *
+ * The failure message reports the number of entries out of tolerance
+ * and the worst one.
+ *
+ * @param x First array to be compared
+ * @param y Second array to be compared
+ * @param len Array length
+ * @param abs Absolute tolerance
+ * @param rel Relative tolerance, scaled by the larger magnitude
+ * @param msg Human readable message, showed when assert fails
+ */
+#define assert_equals_array_close(x, y, len, abs, rel, msg) \
+    _assert_equals_array_close(x, y, len, abs, rel, msg)
+
+/*!
+ * \brief Assert two float arrays have equal entries, within an absolute or a
+ * relative tolerance.
+ *
+ * The failure message reports the number of entries out of tolerance
+ * and the worst one.
+ *
+ * @param x First array to be compared
+ * @param y Second array to be compared
+ * @param len Array length
+ * @param abs Absolute tolerance
+ * @param rel Relative tolerance, scaled by the larger magnitude
+ * @param msg Human readable message, showed when assert fails
+ */
+#define assert_equals_array_close_float(x, y, len, abs, rel, msg) \
+    _assert_equals_array_close_float(x, y, len, abs, rel, msg)
+
+/*!
+ * \brief Assert two double matrixes have equal entries, within a distance in
+ * units in the last place (ulp).
+ *
+ * The failure message reports the number of entries out of tolerance
+ * and the worst one.
+ *
+ * @param x First matrix to be compared
+ * @param y Second matrix to be compared
+ * @param m Number of rows in the matrix
+ * @param n Number of columns in the matrix
+ * @param ulps Maximum distance in ulp (0 requires equal values)
+ * @param msg Human readable message, showed when assert fails
+ */
+#define assert_equals_matrix_ulp(x, y, m, n, ulps, msg) \
+    _assert_equals_matrix_ulp(x, y, m, n, ulps, msg)
+
+/*!
+ * \brief Assert two float matrixes have equal entries, within a distance in
+ * units in the last place (ulp).
+ *
+ * The failure message reports the number of entries out of tolerance
+ * and the worst one.
+ *
+ * @param x First matrix to be compared
+ * @param y Second matrix to be compared
+ * @param m Number of rows in the matrix
+ * @param n Number of columns in the matrix
+ * @param ulps Maximum distance in ulp (0 requires equal values)
+ * @param msg Human readable message, showed when assert fails
+ */
+#define assert_equals_matrix_ulp_float(x, y, m, n, ulps, msg) \
+    _assert_equals_matrix_ulp_float(x, y, m, n, ulps, msg)
+
+/*!
+ * \brief Assert two double matrixes have equal entries, within a relative
+ * tolerance, scaled by the larger magnitude.
+ *
+ * The failure message reports the number of entries out of tolerance
+ * and the worst one.
+ *
+ * @param x First matrix to be compared
+ * @param y Second matrix to be compared
+ * @param m Number of rows in the matrix
+ * @param n Number of columns in the matrix
+ * @param rel Relative tolerance
+ * @param msg Human readable message, showed when assert fails
+ */
+#define assert_equals_matrix_rel(x, y, m, n, rel, msg) \
+    _assert_equals_matrix_rel(x, y, m, n, rel, msg)
+
+/*!
+ * \brief Assert two float matrixes have equal entries, within a relative
+ * tolerance, scaled by the larger magnitude.
+ *
+ * The failure message reports the number of entries out of tolerance
+ * and the worst one.
+ *
+ * @param x First matrix to be compared
+ * @param y Second matrix to be compared
+ * @param m Number of rows in the matrix
+ * @param n Number of columns in the matrix
+ * @param rel Relative tolerance
+ * @param msg Human readable message, showed when assert fails
+ */
+#define assert_equals_matrix_rel_float(x, y, m, n, rel, msg) \
+    _assert_equals_matrix_rel_float(x, y, m, n, rel, msg)
+
+/*!
+ * \brief Assert two double matrixes have equal entries, within an absolute
+ * or a relative tolerance.
+ *
+ * The failure message reports the number of entries out of tolerance
+ * and the worst one.
+ *
+ * @param x First matrix to be compared
+ * @param y Second matrix to be compared
+ * @param m Number of rows in the matrix
+ * @param n Number of columns in the matrix
+ * @param abs Absolute tolerance
+ * @param rel Relative tolerance, scaled by the larger magnitude
+ * @param msg Human readable message, showed when assert fails
+ */
+#define assert_equals_matrix_close(x, y, m, n, abs, rel, msg) \
+    _assert_equals_matrix_close(x, y, m, n, abs, rel, msg)
+
+/*!
+ * \brief Assert two float matrixes have equal entries, within an absolute or
+ * a relative tolerance.
+ *
+ * The failure message reports the number of entries out of tolerance
+ * and the worst one.
+ *
+ * @param x First matrix to be compared
+ * @param y Second matrix to be compared
+ * @param m Number of rows in the matrix
+ * @param n Number of columns in the matrix
+ * @param abs Absolute tolerance
+ * @param rel Relative tolerance, scaled by the larger magnitude
+ * @param msg Human readable message, showed when assert fails
+ */
+#define assert_equals_matrix_close_float(x, y, m, n, abs, rel, msg) \
+    _assert_equals_matrix_close_float(x, y, m, n, abs, rel, msg)
+
+/*!
+ * \brief Assert two arrays have equal entries, of any arithmetic type.
+ *
+ * The type of the entries is deduced with _Generic, and must be the same
+ * for both arrays. Integer arrays are compared as memory, floating point
+ * arrays with the == operator (so NaN entries never match). The failure
+ * message reports the first different entry.
+ *
+ * @param x First array to be compared
+ * @param y Second array to be compared
+ * @param len Array length
+ * @param msg Human readable message, showed when assert fails
+ */
+#define assert_equals_array(x, y, len, msg) \
+    _assert_equals_array(x, y, len, msg)
+
+/*!
+ * \brief Assert two matrixes have equal entries, of any arithmetic type.
+ *
+ * Entries are compared as in assert_equals_array().
+ *
+ * @param x First matrix to be compared
+ * @param y Second matrix to be compared
+ * @param m Number of rows in the matrix
+ * @param n Number of columns in the matrix
+ * @param msg Human readable message, showed when assert fails
+ */
+#define assert_equals_matrix(x, y, m, n, msg) \
+    _assert_equals_matrix(x, y, m, n, msg)
+
+/*!
+ * \brief Assert two strided matrixes have equal entries, of any arithmetic
+ * type.
+ *
+ * Each matrix is described by the pointer to its first entry and by the
+ * distance, in entries, between two consecutive rows and two consecutive
+ * columns, so sub-matrixes and column major matrixes may be compared
+ * without copies. Strides may be negative. Entries are compared as in 
+ * assert_equals_array(), visiting the matrixes in cache friendly tiles.
+ * Matrixes with more than 4M entries are split among threads, as many as
+ * the online CPUs or as set with the <tt>CUTEST_THREADS</tt> environment
+ * variable. The failure message reports the first different entry in row
+ * major order.
+ *
+ * @param x First entry of the first matrix
+ * @param y First entry of the second matrix
+ * @param m Number of rows
+ * @param n Number of columns
+ * @param x_rs Row stride of the first matrix
+ * @param x_cs Column stride of the first matrix
+ * @param y_rs Row stride of the second matrix
+ * @param y_cs Column stride of the second matrix
+ * @param msg Human readable message, showed when assert fails
+ */
+#define assert_equals_matrix_strided(x, y, m, n, x_rs, x_cs, y_rs, y_cs, msg) \
+    _assert_equals_matrix_strided(x, y, m, n, x_rs, x_cs, y_rs, y_cs, msg)
+
+/*!
+ * \brief Assert two strided matrixes have the same floating point entries.
+ *
+ * Matrixes are described as in assert_equals_matrix_strided(), and their
+ * entries are compared as in assert_equals_matrix_flo().
+ *
+ * @param x First entry of the first matrix
+ * @param y First entry of the second matrix
+ * @param m Number of rows
+ * @param n Number of columns
+ * @param x_rs Row stride of the first matrix
+ * @param x_cs Column stride of the first matrix
+ * @param y_rs Row stride of the second matrix
+ * @param y_cs Column stride of the second matrix
+ * @param tol Tolerance for numerical comparison
+ * @param msg Human readable message, showed when assert fails
+ */
+#define assert_equals_matrix_strided_flo(x, y, m, n, x_rs, x_cs, y_rs, y_cs, \
+        tol, msg) \
+    _assert_equals_matrix_strided_flo(x, y, m, n, x_rs, x_cs, y_rs, y_cs, \
+            tol, msg)
+
+/*!
+ * \brief Assert a buffer has the same content of a reference file.
+ *
+ * The reference file is mapped in memory, not copied. The failure message
+ * reports the offset of the first different byte, with the bytes around
+ * it. When the <tt>CUTEST_UPDATE_SNAPSHOTS</tt> environment variable is
+ * set to 1, a missing or different reference file is atomically rewritten
+ * with the content of the buffer, and the assertion succeeds.
+ *
+ * @param buf Buffer to be compared
+ * @param len Buffer length, in bytes
+ * @param path Path of the reference file
+ * @param msg Human readable message, showed when assert fails
+ */
+#define assert_equals_file(buf, len, path, msg) \
+    _assert_equals_file(buf, len, path, msg)
+
+/*!
+ * \brief Assert two files have the same content.
+ *
+ * The second file is the reference, rewritten with the content of the 
+ * first when <tt>CUTEST_UPDATE_SNAPSHOTS</tt> is set, as in 
+ * assert_equals_file().
+ *
+ * @param a Path of the file to be compared
+ * @param b Path of the reference file
+ * @param msg Human readable message, showed when assert fails
+ */
+#define assert_files_equal(a, b, msg) _assert_files_equal(a, b, msg)
+
+/*!
+ * \brief Assert a block of code does not allocate heap memory.
+ *
+ * \code
+ * ASSERT_NO_ALLOC("hot path must not allocate")
+ * {
+ *     process_packet(&ctx, packet);
+ * }
+ * \endcode
+ *
+ * The statement following the macro is executed, and the assertion fails
+ * if it called malloc(), calloc(), realloc() or one of the aligned 
+ * allocation functions from the thread of the test case. Allocations of
+ * other threads are not counted. A break or continue statement inside
+ * the block applies to the assertion, not to an enclosing loop, and a 
+ * block left with break, return or goto makes the test case invalid,
+ * unless an assertion inside the block failed.
+ *
+ * @param msg Human readable message, showed when assert fails
+ */
+#define ASSERT_NO_ALLOC(msg) _ASSERT_NO_ALLOC(msg)
+
+/*!
+ * \brief Assert the test case allocated less than a number of bytes.
+ *
+ * The bytes requested with malloc(), calloc(), realloc() and the aligned
+ * allocation functions from the thread of the test case are counted from
+ * the start of the test case function, excluding BEFORE_TEST(name), and
+ * including freed blocks. The bytes are counted only while allocations
+ * are tracked (see cutest_parse_args(int*, char**)), and the assertion is
+ * invalid otherwise.
+ *
+ * @param n Bound for the allocated bytes
+ * @param msg Human readable message, showed when assert fails
+ */
+#define assert_alloc_bytes_below(n, msg) _assert_alloc_bytes_below(n, msg)
+
+/*!
+ * \brief Assert the peak resident set size is less than a bound.
+ *
+ * The peak of the process running the test case is reset through 
+ * <tt>/proc/self/clear_refs</tt> before its BEFORE_TEST(name) procedure,
+ * in all the suite modes, so it does not include the peak of the runner,
+ * of the BEFORE_ALL(name) fixture or of the previous test cases of a 
+ * worker, but only the pages resident at the start of the test case. The
+ * assertion is invalid when the peak cannot be reset.
+ *
+ * @param bytes Bound for the peak resident set size, in bytes
+ * @param msg Human readable message, showed when assert fails
+ */
+#define assert_max_rss_below(bytes, msg) _assert_max_rss_below(bytes, msg)
+
+/*!
+ * \brief Assert the test case executed less than a number of instructions.
+ *
+ * The instructions are counted in user space by the hardware counters of
+ * the thread of the test case, from the start of the test case function,
+ * when the counters are enabled with the <tt>--perf</tt> option (see
+ * cutest_parse_args()). Instruction counts are much more stable than 
+ * times on noisy machines. The assertion is invalid when the counters
+ * are not enabled, and it always succeeds when the instructions counter
+ * is not available, as told by a notice on the standard error.
+ *
+ * @param n Bound for the instructions executed
+ * @param msg Human readable message, showed when assert fails
+ */
+#define assert_instructions_below(n, msg) _assert_instructions_below(n, msg)
+
 /*!
  * \brief Cause the immediate failure of the current test case.
  * 
@@ -214,6 +810,38 @@
  */
 #define fail(msg) _fail(msg)
 
+/*!
+ * \brief Execution mode where each test case runs in a separate process.
+ *
+ * This is the default mode of a suite.
+ */
+#define SUITE_FORK 0
+
+/*!
+ * \brief Execution mode where test cases run in the runner process.
+ *
+ * Test cases are called directly, without creating a new process. Signals
+ * raised by the code under test (SIGSEGV, SIGFPE, SIGABRT, SIGBUS and
+ * SIGILL) are caught and reported as errors, like in SUITE_FORK mode, but
+ * other side effects of a test case (e.g. corrupted memory or modified
+ * global variables) persist for the following test cases.
+ * Test cases defined with TEST_CASE_FORK(name) still run in a process of 
+ * their own.
+ */
+#define SUITE_NOFORK 1
+
+/*!
+ * \brief Execution mode where test cases run in persistent workers.
+ *
+ * Each parallel job is a worker process, which executes test cases one 
+ * after the other. A worker is replaced only when it terminates 
+ * abnormally (e.g. after a signal), so test cases are isolated from the
+ * runner but not from the other test cases executed by the same worker.
+ * Test cases defined with TEST_CASE_FORK(name) still run in a process of 
+ * their own.
+ */
+#define SUITE_WORKERS 2
+
 /*!
  * \brief Type for a suite of test cases.
  *
@@ -251,11 +879,75 @@
 typedef struct suite
 {
     char name[NAME_LEN]; /*!< Human readable name for the suite */
-    ll_list asserts; /*!< Linked list containing pointers to test cases */
+    Test_case *tests; /*!< Array of test cases, in insertion order */
+    unsigned int tests_len; /*!< Number of test cases */
+    unsigned int tests_cap; /*!< Allocated size of the test cases array */
+    ll_list benchmarks; /*!< Linked list containing pointers to benchmarks */
     void (*before)(void); /*!< Name of eventual BEFORE_TEST(name) procedure */
     void (*after)(void);   /*!< Name of eventual AFTER_TEST(name) procedure */
+    void (*before_all)(void); /*!< Eventual BEFORE_ALL(name) procedure */
+    void (*after_all)(void);  /*!< Eventual AFTER_ALL(name) procedure */
+    int mode; /*!< Execution mode (SUITE_FORK, SUITE_NOFORK, SUITE_WORKERS) */
+    long timeout; /*!< Timeout for each test case in milliseconds, 0 if none */
 } Suite;
 
+/*!
+ * \brief A type summarizing a suite run, passed to the reporters.
+ */
+typedef struct summary
+{
+    int tests;     /*!< Number of test cases executed in the suite */
+    int successes; /*!< Number of successful test cases */
+    int failures;  /*!< Number of test cases with a failed assertion */
+    int errors;    /*!< Number of test cases terminated with an error */
+    long wall_us;  /*!< Wall clock time of the suite run, in microseconds */
+    int skipped;   /*!< Number of test cases not selected */
+    int cancelled; /*!< Number of test cases cancelled by fail fast */
+    int after_all_sig;    /*!< Signal terminating AFTER_ALL(name), or 0 */
+    int after_all_status; /*!< Exit status of AFTER_ALL(name), or 0 */
+    Test_case *const *tcs; /*!< Selected test cases, in suite order */
+    const Result *results; /*!< Outcome of each test case, or cancelled */
+} Summary;
+
+/*!
+ * \brief A type for a reporter, receiving the events of the suite runs.
+ *
+ * Results are reported in suite order, as soon as they are available.
+ * The built-in reporters are created with reporter_junit(int fd), 
+ * reporter_jsonl(int fd) and reporter_tap(int fd), and may also be
+ * selected with the <tt>CUTEST_REPORTER</tt> environment variable, a 
+ * comma separated list of <tt>kind[:path]</tt> items, where kind is
+ * <tt>console</tt>, <tt>junit</tt>, <tt>jsonl</tt> or <tt>tap</tt>, and
+ * path defaults to the standard output.
+ *
+ * \code
+ * CUTEST_REPORTER=console,junit:report.xml ./test
+ * \endcode
+ */
+typedef struct reporter
+{
+    /*! Called when a suite run starts */
+    void (*start_suite)(struct reporter *rep, const Suite *s, int tests);
+    /*! Called for each completed test case */
+    void (*test_result)(
+            struct reporter *rep,
+            const Suite *s,
+            const Test_case *tc,
+            const Result *res);
+    /*! Called when a suite run ends */
+    void (*end_suite)(struct reporter *rep, const Suite *s, const Summary *sum);
+    /*! Called at program exit, may be NULL */
+    void (*close)(struct reporter *rep);
+    void *data; /*!< State of the reporter */
+    /*! Called for each completed benchmark, after the end of its suite, 
+     *  may be NULL */
+    void (*bench_result)(
+            struct reporter *rep,
+            const Suite *s,
+            const Benchmark *bm,
+            const Bench_stats *bs);
+} Reporter;
+
 /*!
  * \brief Initialize a new suite.
  *
@@ -271,6 +963,35 @@ int suite_new(
         void (*aft)(void)
         );
 
+/*!
+ * \brief Initialize a new suite, with procedures executed once per run.
+ *
+ * The BEFORE_ALL(name) procedure runs once, before the test cases, in a
+ * fixture process from which all the test case processes are forked.
+ * In SUITE_NOFORK mode, both procedures run in the runner process.
+ *
+ * \code
+ * Suite *s;
+ * suite_new_all(&s, "Suite name", before_proc, after_proc,
+ *         load_dataset, free_dataset);
+ * \endcode
+ *
+ * @param s Suite to be initialized
+ * @param name Human readable name for the suite
+ * @param bef Name of the BEFORE_TEST(name) procedure (set to NULL if none)
+ * @param aft Name of the AFTER_TEST(name) procedure (set to NULL if none)
+ * @param bef_all Name of the BEFORE_ALL(name) procedure (NULL if none)
+ * @param aft_all Name of the AFTER_ALL(name) procedure (NULL if none)
+ */
+int suite_new_all(
+        Suite **s,
+        const char *name,
+        void (*bef)(void),
+        void (*aft)(void),
+        void (*bef_all)(void),
+        void (*aft_all)(void)
+        );
+
 /*!
  * \brief Add a test case to a suite
  *
@@ -280,9 +1001,225 @@ int suite_new(
  */
 int suite_add(Suite *s, void (*t)(Status*), const char *name);
 
+/*!
+ * \brief Add a benchmark to a suite
+ *
+ * Benchmarks are executed sequentially by suite_run(Suite *s), after the
+ * test cases of the suite, each one in a separate process.
+ *
+ * @param s Suite
+ * @param b Name of a previously definited benchmark
+ * @param name String with a descriptive name for the benchmark
+ */
+int suite_add_benchmark(Suite *s, void (*b)(Bench*), const char *name);
+
+/*!
+ * \brief Set the execution mode of a suite.
+ *
+ * The mode can be overridden with the <tt>CUTEST_MODE</tt> environment
+ * variable, set to <tt>fork</tt>, <tt>nofork</tt> or <tt>workers</tt>.
+ *
+ * @param s Suite
+ * @param mode Execution mode, SUITE_FORK (default), SUITE_NOFORK or
+ * SUITE_WORKERS
+ */
+int suite_set_mode(Suite *s, int mode);
+
+/*!
+ * \brief Set a timeout for the test cases of a suite.
+ *
+ * A test case whose execution lasts more than the timeout is killed and
+ * counted as failed with error. The AFTER_TEST procedure is still executed,
+ * with the same timeout. Test cases declared with 
+ * TEST_CASE_TIMEOUT(name, ms) use their own timeout. When the suite has
+ * no timeout, the <tt>CUTEST_TIMEOUT</tt> environment variable provides a
+ * default value.
+ *
+ * @param s Suite
+ * @param ms Timeout in milliseconds, 0 for no timeout
+ */
+int suite_set_timeout(Suite *s, long ms);
+
 /*!
  * \brief Run a suite of test cases.
  *
  * @param s Suite to be executed
  */
 int suite_run(Suite *s);
+
+/*!
+ * \brief Run a suite of test cases using parallel processes.
+ *
+ * Up to <code>jobs</code> test cases are executed at the same time, each
+ * one in its own process. The output is the same produced by 
+ * suite_run(Suite *s), with messages printed in the suite order.
+ *
+ * The duration of each test case is recorded in a timing cache file, 
+ * <tt>.cutest-cache</tt> in the working directory, or the path set with
+ * the <tt>CUTEST_CACHE</tt> environment variable (empty to disable it).
+ * With more than one job, test cases are started from the longest one,
+ * according to the cache, so that long test cases do not delay the end
+ * of the run.
+ *
+ * The number of jobs can be overridden with the <tt>CUTEST_JOBS</tt>
+ * environment variable, which also applies to suite_run(Suite *s).
+ * A value less than one means one job for each online processor.
+ *
+ * @param s Suite to be executed
+ * @param jobs Maximum number of test cases running at the same time
+ */
+int suite_run_parallel(Suite *s, int jobs);
+
+/*!
+ * \brief Get a read only fixture shared by all the test case processes.
+ *
+ * The first call with a given name creates a memory file of 
+ * <code>size</code> bytes, fills it calling <code>init</code>, seals it
+ * against writes and maps it read only. The following calls with the same
+ * name return the same mapping. When the fixture is built before running
+ * the suites, or in a BEFORE_ALL(name) procedure, all the test case 
+ * processes and workers inherit the mapping, so a single copy of the data
+ * exists regardless of the number of jobs, and a test case writing to it
+ * is terminated by a signal instead of altering the data seen by others.
+ *
+ * \code
+ * static void fill_table(void *data, size_t size)
+ * {
+ *     // write the table
+ * }
+ *
+ * const double *table = cutest_shared_fixture("table", n * sizeof (double),
+ *         fill_table);
+ * \endcode
+ *
+ * @param name Name of the fixture
+ * @param size Size of the fixture, in bytes
+ * @param init Function writing the content of the fixture
+ * @return Pointer to the read only content of the fixture
+ */
+const void* cutest_shared_fixture(
+        const char *name,
+        size_t size,
+        void (*init)(void *data, size_t size));
+
+/*!
+ * \brief Add a reporter.
+ *
+ * The reporter receives the events of the following suite runs, in
+ * addition to the reporters selected with the <tt>CUTEST_REPORTER</tt>
+ * environment variable (or the console reporter, if it is not set).
+ *
+ * @param rep Reporter
+ */
+int cutest_add_reporter(Reporter *rep);
+
+/*!
+ * \brief Create a reporter writing a JUnit XML document.
+ *
+ * The output is buffered, and the document is completed at program exit.
+ *
+ * @param fd Output file descriptor
+ */
+Reporter* reporter_junit(int fd);
+
+/*!
+ * \brief Create a reporter writing a JSON Lines stream.
+ *
+ * Each line is a JSON object, recording the start of a suite, the outcome
+ * of a test case or the end of a suite.
+ *
+ * @param fd Output file descriptor
+ */
+Reporter* reporter_jsonl(int fd);
+
+/*!
+ * \brief Create a reporter writing a TAP version 13 stream.
+ *
+ * Test points are numbered across suites, and the plan is written at
+ * program exit.
+ *
+ * @param fd Output file descriptor
+ */
+Reporter* reporter_tap(int fd);
+
+/*!
+ * \brief Run all the test cases registered automatically.
+ *
+ * When <tt>CUTEST_AUTO_REGISTER</tt> is defined before including this
+ * header (e.g. with <tt>-DCUTEST_AUTO_REGISTER</tt>), each test case
+ * emits a static descriptor in a dedicated linker section, and no call
+ * to suite_add(Suite*, void (*)(Status*), const char*) is needed. The
+ * test cases of each source file are run as a suite named after the file,
+ * in order of definition, with no BEFORE_TEST or AFTER_TEST procedure.
+ * The return value is meant to be used as the exit status of the test
+ * program, so that a failing run is detected by scripts and CI systems.
+ *
+ * \code
+ * #define CUTEST_AUTO_REGISTER
+ * #include <cutest.h>
+ *
+ * TEST_CASE(test_name)
+ * {
+ *     assert(1 + 1 == 2, "Sum");
+ * }
+ *
+ * int main()
+ * {
+ *     return cutest_run_all();
+ * }
+ * \endcode
+ *
+ * @return 1 if any test case failed or terminated with an error, 0
+ * otherwise (also when no test case is registered).
+ */
+int cutest_run_all(void);
+
+/*!
+ * \brief Parse the command line options of a test program.
+ *
+ * Recognized options are removed from the arguments:
+ *  - <tt>--filter=PATTERNS</tt>: run only the test cases matching a comma
+ *    separated list of glob patterns, against the test case name or
+ *    <tt>suite/test</tt>. Patterns starting with <tt>!</tt> exclude the
+ *    matching test cases. The default is the <tt>CUTEST_FILTER</tt>
+ *    environment variable.
+ *  - <tt>--shard=i/N</tt>: run only the i-th of N shards (1 <= i <= N),
+ *    to split the test cases of the same program among N machines. The
+ *    selected test cases are assigned to shards in round robin, in the
+ *    order of the suites runs, so shards are balanced and do not change
+ *    between runs. The default is the <tt>CUTEST_SHARD</tt> environment 
+ *    variable.
+ *  - <tt>--shard-by=time</tt>: balance the shards by the durations
+ *    recorded in the timing cache, instead of assigning test cases in
+ *    round robin (<tt>--shard-by=index</tt>). All the shards must read
+ *    the same cache file, or they may select overlapping test cases. The
+ *    default is the <tt>CUTEST_SHARD_BY</tt> environment variable.
+ *  - <tt>--max-failures=N</tt>: stop after N failed test cases, killing
+ *    the running ones and cancelling the others, in the current and in
+ *    the following suites. The default is the <tt>CUTEST_MAX_FAILURES</tt>
+ *    environment variable.
+ *  - <tt>--fail-fast</tt>: same as <tt>--max-failures=1</tt>.
+ *  - <tt>--failed-first</tt>: start the test cases failed in the previous
+ *    run, according to the timing cache, before the others. Results are
+ *    still reported in suite order. The default is the 
+ *    <tt>CUTEST_FAILED_FIRST</tt> environment variable.
+ *  - <tt>--track-alloc</tt>: count the heap allocations of each test case,
+ *    from the start of BEFORE_TEST to the end of AFTER_TEST, and report
+ *    the blocks not freed as leaks. The functions of the allocator of the
+ *    GNU C library are interposed, and the tracking is not available with
+ *    other C libraries. Blocks allocated before BEFORE_TEST and freed by
+ *    the test case make the leak count negative. The default is the 
+ *    <tt>CUTEST_TRACK_ALLOC</tt> environment variable.
+ *  - <tt>--perf</tt>: read the hardware counters of cycles, instructions,
+ *    cache misses and branch misses of each test case function and of
+ *    each benchmark, with perf_event_open(). Counters not available, e.g.
+ *    in virtual machines or with a restrictive 
+ *    <tt>/proc/sys/kernel/perf_event_paranoid</tt>, are not reported.
+ *    The default is the <tt>CUTEST_PERF</tt> environment variable.
+ *
+ * Test cases not selected are not executed.
+ *
+ * @param argc Pointer to the number of arguments
+ * @param argv Arguments, as passed to main()
+ */
+int cutest_parse_args(int *argc, char **argv);
@@ -22,12 +22,107 @@
  */
 #define NAME_LEN 100
 
+/*
+ * Maximum number of characters in the message of a failed or invalid 
+ * assertion.
+ */
+#define MSG_LEN 512
+
+/*
+ * Maximum number of characters of an assertion and of a source file name
+ * returned by a child process.
+ */
+#define ASSERTION_LEN 512
+#define FILE_LEN 256
+
 /*
  * Mask the definition of a function with the name provided as
  * input and a parameter used to return the execution result to the
  * runner which calls the test.
  */
-#define _TEST_CASE(name) void (name)(Status *__s)
+#define _TEST_CASE_FUN(name) void (name)(Status *__s)
+
+/*
+ * Stringify the expansion of a macro.
+ */
+#define _STR(x) _STR_(x)
+#define _STR_(x) #x
+
+/*
+ * Name of the linker section collecting the test case descriptors.
+ */
+#define _TEST_SECTION cutest_tests
+
+/*
+ * Emit a static descriptor of the test case in a dedicated section, where
+ * cutest_run_all() finds it without any registration at runtime. The
+ * linker defines the __start_ and __stop_ symbols delimiting the section.
+ * The explicit alignment prevents the compiler from padding descriptors,
+ * so that the section is an array.
+ */
+#define _TEST_CASE_DESC(name, fl, ms) \
+    _TEST_CASE_FUN(name); \
+    static Test_case name##__desc \
+        __attribute__((used, section(_STR(_TEST_SECTION)), \
+                    aligned(__alignof__(Test_case)))) = \
+        {(name), #name, (fl), (ms), __FILE__, __LINE__}
+
+/*
+ * Register the test case, emitting its descriptor, when automatic
+ * registration is enabled with CUTEST_AUTO_REGISTER.
+ */
+#ifdef CUTEST_AUTO_REGISTER
+#define _TEST_CASE_REG(name, fl, ms) _TEST_CASE_DESC(name, fl, ms);
+#else
+#define _TEST_CASE_REG(name, fl, ms)
+#endif
+
+/*
+ * Mask the definition of a test case.
+ */
+#define _TEST_CASE(name) \
+    _TEST_CASE_REG(name, 0, 0) \
+    _TEST_CASE_FUN(name)
+
+/*
+ * Mask the definition of a test case with attributes. A constructor
+ * records the attributes of the function before main() is entered, and
+ * suite_add() applies them to the test case.
+ */
+#define _TEST_CASE_ATTR(name, flags, timeout) \
+    _TEST_CASE_REG(name, (flags), (timeout)) \
+    _TEST_CASE_FUN(name); \
+    static void __attribute__((constructor)) name##__attr(void) \
+    { \
+        __test_set_attr((name), (flags), (timeout)); \
+    } \
+    _TEST_CASE_FUN(name)
+
+/*
+ * Mask the definition of a benchmark function, with a parameter carrying
+ * the number of iterations and the time measures.
+ */
+#define _BENCHMARK(name) void (name)(Bench *__b)
+
+/*
+ * Time the loop which follows, executing it the number of times requested
+ * by the runner.
+ */
+#define _BENCHMARK_LOOP \
+    for (size_t __i = __bench_start(__b); \
+            __i > 0 || __bench_stop(__b); \
+            --__i)
+
+/*
+ * Make the compiler assume that the value is used, and that memory may 
+ * have been read.
+ */
+#define _do_not_optimize(x) __asm__ volatile("" : : "g"(x) : "memory")
+
+/*
+ * Make the compiler assume that all memory may have been read or written.
+ */
+#define _clobber() __asm__ volatile("" : : : "memory")
 
 /*
  * Mask the definition of a procedure to be executed before each test case.
@@ -39,14 +134,28 @@
  */
 #define _AFTER_TEST(name) void name(void)
 
+/*
+ * Mask the definition of the procedures executed once per suite run.
+ */
+#define _BEFORE_ALL(name) void name(void)
+#define _AFTER_ALL(name) void name(void)
+
+/*
+ * Record the assertion being checked, with its position in the source.
+ */
+#define __assertion(text) \
+    __s->assertion = (text); \
+    __s->file = __FILE__; \
+    __s->line = __LINE__
+
 /*
  * Check the assertion. Write the assertion expression in a string, for the 
  * output, check the condition and return if assertion failed.
  */
 #define _assert(expr, msg) \
-    __s->assertion = ("assert("#expr", "#msg")"); \
+    __assertion("assert("#expr", "#msg")"); \
     __s->failed = !(expr); \
-    __s->invalid = NULL; \
+    __s->invalid = 0; \
     if (__s->failed) return;
 
 /*
@@ -54,9 +163,9 @@
  * output, check the condition and return if assertion failed.
  */
 #define _assert_false(expr, msg) \
-    __s->assertion = ("assert_false("#expr", "#msg")"); \
+    __assertion("assert_false("#expr", "#msg")"); \
     __s->failed = (expr); \
-    __s->invalid = NULL; \
+    __s->invalid = 0; \
     if (__s->failed) return;
 
 /*
@@ -64,9 +173,9 @@
  * output, check the condition and return if assertion failed.
  */
 #define _assert_equals_int(x, y, msg) \
-    __s->assertion = ("assert_equals_int("#x", "#y", "#msg")"); \
+    __assertion("assert_equals_int("#x", "#y", "#msg")"); \
     __s->failed = !((x) == (y)); \
-    __s->invalid = NULL; \
+    __s->invalid = 0; \
     if (__s->failed) return;
 
 /*
@@ -74,7 +183,7 @@
  * output, check the condition and return if assertion failed.
  */
 #define _assert_equals_flo(x, y, tol, msg) \
-    __s->assertion = ("assert_equals_flo("#x", "#y", "#tol", "#msg")"); \
+    __assertion("assert_equals_flo("#x", "#y", "#tol", "#msg")"); \
     __assert_equals_flo((x), (y), (tol), __s); \
     if (__s->failed) return;
 
@@ -83,27 +192,27 @@
  * output, check the condition and return if assertion failed.
  */
 #define _assert_equals_str(x, y, msg) \
-    __s->assertion = ("assert_equals_str("#x", "#y", "#msg")"); \
+    __assertion("assert_equals_str("#x", "#y", "#msg")"); \
     __s->failed = strcmp((x), (y)); \
-    __s->invalid = NULL; \
+    __s->invalid = 0; \
     if (__s->failed) return;
 
 /*
  * Check if a pointer is NULL.
  */
 #define _assert_null(x, msg) \
-    __s->assertion = ("assert_null("#x", "#msg")"); \
+    __assertion("assert_null("#x", "#msg")"); \
     __s->failed = (x != NULL); \
-    __s->invalid = NULL; \
+    __s->invalid = 0; \
     if (__s->failed) return;
 
 /*
  * Check if a pointer is not NULL.
  */
 #define _assert_not_null(x, msg) \
-    __s->assertion = ("assert_not_null("#x", "#msg")"); \
+    __assertion("assert_not_null("#x", "#msg")"); \
     __s->failed = (x == NULL); \
-    __s->invalid = NULL; \
+    __s->invalid = 0; \
     if (__s->failed) return;
 
 /*
@@ -111,7 +220,7 @@
  * output, check the condition and return if assertion failed.
  */
 #define _assert_equals_array_int(x, y, len, msg) \
-    __s->assertion = ("assert_equals_array_int("#x", "#y", "#len", "#msg")"); \
+    __assertion("assert_equals_array_int("#x", "#y", "#len", "#msg")"); \
     __assert_equals_array_int((x), (y), (len), __s); \
     if (__s->failed) return;
 
@@ -120,7 +229,7 @@
  * output, check the condition and return if assertion failed.
  */
 #define _assert_equals_array_flo(x, y, len, tol, msg) \
-    __s->assertion = ("assert_equals_array_flo(" \
+    __assertion("assert_equals_array_flo(" \
             #x", "#y", "#len", "#tol", "#msg")"); \
     __assert_equals_array_flo((x), (y), (len), (tol), __s); \
     if (__s->failed) return;
@@ -130,7 +239,7 @@
  * output, check the condition and return if assertion failed.
  */
 #define _assert_equals_matrix_int(x, y, m, n, msg) \
-    __s->assertion = ("assert_equals_matrix_int(" \
+    __assertion("assert_equals_matrix_int(" \
             #x", "#y", "#m", "#n", "#msg")"); \
     __assert_equals_matrix_int((m), (n), (x), (y), __s); \
     if (__s->failed) return;
@@ -140,17 +249,297 @@
  * output, check the condition and return if assertion failed.
  */
 #define _assert_equals_matrix_flo(x, y, m, n, tol, msg) \
-    __s->assertion = ("assert_equals_matrix_flo(" \
+    __assertion("assert_equals_matrix_flo(" \
             #x", "#y", "#m", "#n", "#tol", "#msg")"); \
     __assert_equals_matrix_flo((m), (n), (x), (y), (tol), __s); \
     if (__s->failed) return;
 
+/*
+ * Shapes of the values compared by the tolerance assertions, used to
+ * describe the position of the worst entry.
+ */
+#define SHAPE_SCALAR 0
+#define SHAPE_ARRAY  1
+#define SHAPE_MATRIX 2
+
+/*
+ * Check the assertion. Scalars are compared as arrays of one entry,
+ * built with compound literals, so each argument is evaluated once.
+ */
+#define _assert_equals_ulp(x, y, ulps, msg) \
+    __assertion("assert_equals_ulp("#x", "#y", "#ulps", "#msg")"); \
+    __assert_ulp_dbl((double[]) {(x)}, (double[]) {(y)}, \
+            1, 1, SHAPE_SCALAR, (ulps), __s); \
+    if (__s->failed) return;
+
+#define _assert_equals_ulp_float(x, y, ulps, msg) \
+    __assertion("assert_equals_ulp_float("#x", "#y", "#ulps", "#msg")"); \
+    __assert_ulp_flt((float[]) {(x)}, (float[]) {(y)}, \
+            1, 1, SHAPE_SCALAR, (ulps), __s); \
+    if (__s->failed) return;
+
+#define _assert_equals_rel(x, y, rel, msg) \
+    __assertion("assert_equals_rel("#x", "#y", "#rel", "#msg")"); \
+    __assert_close_dbl((double[]) {(x)}, (double[]) {(y)}, \
+            1, 1, SHAPE_SCALAR, 0.0, (rel), __s); \
+    if (__s->failed) return;
+
+#define _assert_equals_rel_float(x, y, rel, msg) \
+    __assertion("assert_equals_rel_float("#x", "#y", "#rel", "#msg")"); \
+    __assert_close_flt((float[]) {(x)}, (float[]) {(y)}, \
+            1, 1, SHAPE_SCALAR, 0.0, (rel), __s); \
+    if (__s->failed) return;
+
+#define _assert_equals_close(x, y, abs, rel, msg) \
+    __assertion("assert_equals_close("#x", "#y", "#abs", "#rel", "#msg")"); \
+    __assert_close_dbl((double[]) {(x)}, (double[]) {(y)}, \
+            1, 1, SHAPE_SCALAR, (abs), (rel), __s); \
+    if (__s->failed) return;
+
+#define _assert_equals_close_float(x, y, abs, rel, msg) \
+    __assertion("assert_equals_close_float(" \
+            #x", "#y", "#abs", "#rel", "#msg")"); \
+    __assert_close_flt((float[]) {(x)}, (float[]) {(y)}, \
+            1, 1, SHAPE_SCALAR, (abs), (rel), __s); \
+    if (__s->failed) return;
+
+/*
+ * Check the assertion on arrays, seen as matrixes of a single column.
+ */
+#define _assert_equals_array_ulp(x, y, len, ulps, msg) \
+    __assertion("assert_equals_array_ulp(" \
+            #x", "#y", "#len", "#ulps", "#msg")"); \
+    __assert_ulp_dbl((x), (y), (len), 1, SHAPE_ARRAY, (ulps), __s); \
+    if (__s->failed) return;
+
+#define _assert_equals_array_ulp_float(x, y, len, ulps, msg) \
+    __assertion("assert_equals_array_ulp_float(" \
+            #x", "#y", "#len", "#ulps", "#msg")"); \
+    __assert_ulp_flt((x), (y), (len), 1, SHAPE_ARRAY, (ulps), __s); \
+    if (__s->failed) return;
+
+#define _assert_equals_array_rel(x, y, len, rel, msg) \
+    __assertion("assert_equals_array_rel(" \
+            #x", "#y", "#len", "#rel", "#msg")"); \
+    __assert_close_dbl((x), (y), (len), 1, SHAPE_ARRAY, 0.0, (rel), __s); \
+    if (__s->failed) return;
+
+#define _assert_equals_array_rel_float(x, y, len, rel, msg) \
+    __assertion("assert_equals_array_rel_float(" \
+            #x", "#y", "#len", "#rel", "#msg")"); \
+    __assert_close_flt((x), (y), (len), 1, SHAPE_ARRAY, 0.0, (rel), __s); \
+    if (__s->failed) return;
+
+#define _assert_equals_array_close(x, y, len, abs, rel, msg) \
+    __assertion("assert_equals_array_close(" \
+            #x", "#y", "#len", "#abs", "#rel", "#msg")"); \
+    __assert_close_dbl((x), (y), (len), 1, SHAPE_ARRAY, (abs), (rel), __s); \
+    if (__s->failed) return;
+
+#define _assert_equals_array_close_float(x, y, len, abs, rel, msg) \
+    __assertion("assert_equals_array_close_float(" \
+            #x", "#y", "#len", "#abs", "#rel", "#msg")"); \
+    __assert_close_flt((x), (y), (len), 1, SHAPE_ARRAY, (abs), (rel), __s); \
+    if (__s->failed) return;
+
+/*
+ * Check the assertion on matrixes, whose rows are contiguous.
+ */
+#define _assert_equals_matrix_ulp(x, y, m, n, ulps, msg) \
+    __assertion("assert_equals_matrix_ulp(" \
+            #x", "#y", "#m", "#n", "#ulps", "#msg")"); \
+    __assert_ulp_dbl(&(x)[0][0], &(y)[0][0], (m), (n), SHAPE_MATRIX, \
+            (ulps), __s); \
+    if (__s->failed) return;
+
+#define _assert_equals_matrix_ulp_float(x, y, m, n, ulps, msg) \
+    __assertion("assert_equals_matrix_ulp_float(" \
+            #x", "#y", "#m", "#n", "#ulps", "#msg")"); \
+    __assert_ulp_flt(&(x)[0][0], &(y)[0][0], (m), (n), SHAPE_MATRIX, \
+            (ulps), __s); \
+    if (__s->failed) return;
+
+#define _assert_equals_matrix_rel(x, y, m, n, rel, msg) \
+    __assertion("assert_equals_matrix_rel(" \
+            #x", "#y", "#m", "#n", "#rel", "#msg")"); \
+    __assert_close_dbl(&(x)[0][0], &(y)[0][0], (m), (n), SHAPE_MATRIX, \
+            0.0, (rel), __s); \
+    if (__s->failed) return;
+
+#define _assert_equals_matrix_rel_float(x, y, m, n, rel, msg) \
+    __assertion("assert_equals_matrix_rel_float(" \
+            #x", "#y", "#m", "#n", "#rel", "#msg")"); \
+    __assert_close_flt(&(x)[0][0], &(y)[0][0], (m), (n), SHAPE_MATRIX, \
+            0.0, (rel), __s); \
+    if (__s->failed) return;
+
+#define _assert_equals_matrix_close(x, y, m, n, abs, rel, msg) \
+    __assertion("assert_equals_matrix_close(" \
+            #x", "#y", "#m", "#n", "#abs", "#rel", "#msg")"); \
+    __assert_close_dbl(&(x)[0][0], &(y)[0][0], (m), (n), SHAPE_MATRIX, \
+            (abs), (rel), __s); \
+    if (__s->failed) return;
+
+#define _assert_equals_matrix_close_float(x, y, m, n, abs, rel, msg) \
+    __assertion("assert_equals_matrix_close_float(" \
+            #x", "#y", "#m", "#n", "#abs", "#rel", "#msg")"); \
+    __assert_close_flt(&(x)[0][0], &(y)[0][0], (m), (n), SHAPE_MATRIX, \
+            (abs), (rel), __s); \
+    if (__s->failed) return;
+
+/*
+ * Types of the entries of the arrays compared by the type generic
+ * assertions.
+ */
+#define TYPE_CHAR      1
+#define TYPE_SCHAR     2
+#define TYPE_UCHAR     3
+#define TYPE_SHORT     4
+#define TYPE_USHORT    5
+#define TYPE_INT       6
+#define TYPE_UINT      7
+#define TYPE_LONG      8
+#define TYPE_ULONG     9
+#define TYPE_LONGLONG  10
+#define TYPE_ULONGLONG 11
+#define TYPE_FLOAT     12
+#define TYPE_DOUBLE    13
+
+/*
+ * Code of the type of an expression. Types without a code do not compile.
+ */
+#define _TYPE_CODE(v) _Generic((v), \
+    char: TYPE_CHAR, \
+    signed char: TYPE_SCHAR, \
+    unsigned char: TYPE_UCHAR, \
+    short: TYPE_SHORT, \
+    unsigned short: TYPE_USHORT, \
+    int: TYPE_INT, \
+    unsigned int: TYPE_UINT, \
+    long: TYPE_LONG, \
+    unsigned long: TYPE_ULONG, \
+    long long: TYPE_LONGLONG, \
+    unsigned long long: TYPE_ULONGLONG, \
+    float: TYPE_FLOAT, \
+    double: TYPE_DOUBLE)
+
+/*
+ * Check the assertion, passing the type of the entries of both arrays.
+ */
+#define _assert_equals_array(x, y, len, msg) \
+    __assertion("assert_equals_array("#x", "#y", "#len", "#msg")"); \
+    __assert_equals_typed((x), (y), (len), 1, SHAPE_ARRAY, \
+            _TYPE_CODE((x)[0]), _TYPE_CODE((y)[0]), __s); \
+    if (__s->failed) return;
+
+/*
+ * Check the assertion, passing the type of the entries of both matrixes.
+ */
+#define _assert_equals_matrix(x, y, m, n, msg) \
+    __assertion("assert_equals_matrix("#x", "#y", "#m", "#n", "#msg")"); \
+    __assert_equals_typed(&(x)[0][0], &(y)[0][0], (m), (n), SHAPE_MATRIX, \
+            _TYPE_CODE((x)[0][0]), _TYPE_CODE((y)[0][0]), __s); \
+    if (__s->failed) return;
+
+/*
+ * Check the assertion, passing the strides in a compound literal.
+ */
+#define _assert_equals_matrix_strided(x, y, m, n, x_rs, x_cs, y_rs, y_cs, \
+        msg) \
+    __assertion("assert_equals_matrix_strided(" \
+            #x", "#y", "#m", "#n", "#x_rs", "#x_cs", "#y_rs", "#y_cs", " \
+            #msg")"); \
+    __assert_equals_strided((x), (y), (m), (n), \
+            (const ptrdiff_t[]) {(x_rs), (x_cs), (y_rs), (y_cs)}, \
+            _TYPE_CODE((x)[0]), _TYPE_CODE((y)[0]), __s); \
+    if (__s->failed) return;
+
+/*
+ * Check the assertion, passing the strides in a compound literal.
+ */
+#define _assert_equals_matrix_strided_flo(x, y, m, n, x_rs, x_cs, y_rs, \
+        y_cs, tol, msg) \
+    __assertion("assert_equals_matrix_strided_flo(" \
+            #x", "#y", "#m", "#n", "#x_rs", "#x_cs", "#y_rs", "#y_cs", " \
+            #tol", "#msg")"); \
+    __assert_equals_strided_flo((x), (y), (m), (n), \
+            (const ptrdiff_t[]) {(x_rs), (x_cs), (y_rs), (y_cs)}, \
+            (tol), __s); \
+    if (__s->failed) return;
+
+/*
+ * Check the assertion. Write the assertion expression in a string, for the 
+ * output, check the condition and return if assertion failed.
+ */
+#define _assert_equals_file(buf, len, path, msg) \
+    __assertion("assert_equals_file("#buf", "#len", "#path", "#msg")"); \
+    __assert_equals_file((buf), (len), (path), __s); \
+    if (__s->failed) return;
+
+/*
+ * Check the assertion. Write the assertion expression in a string, for the 
+ * output, check the condition and return if assertion failed.
+ */
+#define _assert_files_equal(a, b, msg) \
+    __assertion("assert_files_equal("#a", "#b", "#msg")"); \
+    __assert_files_equal((a), (b), __s); \
+    if (__s->failed) return;
+
+/*
+ * Check the assertion after the execution of the statement following the
+ * macro. The loop runs the statement once, in the else branch, with the
+ * allocation counters of the thread saved, and then checks the counters
+ * in the other branch. The cleanup of the saved counters, run however 
+ * the loop is left, closes the region and records it when the statement
+ * left it before the check, so that the test case is marked invalid.
+ */
+#define _ASSERT_NO_ALLOC(msg) \
+    for (Alloc_region __r __attribute__((cleanup(__alloc_region_end))) = \
+            __alloc_region_start("ASSERT_NO_ALLOC("#msg")", __FILE__, \
+                __LINE__, __s); ; __r.done = 1) \
+        if (__r.done) \
+        { \
+            __assertion("ASSERT_NO_ALLOC("#msg")"); \
+            __assert_no_alloc(&__r, __s); \
+            if (__s->failed) return; \
+            break; \
+        } \
+        else
+
+/*
+ * Check the assertion. Write the assertion expression in a string, for the 
+ * output, check the condition and return if assertion failed.
+ */
+#define _assert_alloc_bytes_below(n, msg) \
+    __assertion("assert_alloc_bytes_below("#n", "#msg")"); \
+    __assert_alloc_bytes_below((n), __s); \
+    if (__s->failed) return;
+
+/*
+ * Check the assertion. Write the assertion expression in a string, for the 
+ * output, check the condition and return if assertion failed.
+ */
+#define _assert_max_rss_below(bytes, msg) \
+    __assertion("assert_max_rss_below("#bytes", "#msg")"); \
+    __assert_max_rss_below((bytes), __s); \
+    if (__s->failed) return;
+
+/*
+ * Check the assertion. Write the assertion expression in a string, for the 
+ * output, check the condition and return if assertion failed.
+ */
+#define _assert_instructions_below(n, msg) \
+    __assertion("assert_instructions_below("#n", "#msg")"); \
+    __assert_instructions_below((n), __s); \
+    if (__s->failed) return;
+
 /*
  * Cause the test case to fail.
  */
 #define _fail(msg) \
-    __s->assertion = "Reached a fail() statement: " #msg; \
+    __assertion("Reached a fail() statement: " #msg); \
     __s->failed = 1; \
+    __s->invalid = 0; \
     return;
 
 /*
@@ -161,7 +550,10 @@ typedef struct status
 {
     const char *assertion; /* string containing the current assertion */
     int failed;            /* 0 if assert was ok, nonzero otherwise */
-    const char *invalid;   /* NULL if assert was ok, non-NULL otherwise */
+    int invalid;           /* 0 if assert was valid, nonzero otherwise */
+    const char *file;      /* source file of the current assertion */
+    int line;              /* source line of the current assertion */
+    char message[MSG_LEN]; /* explanation of a failed or invalid assertion */
 } Status;
 
 /*
@@ -173,8 +565,793 @@ typedef struct test_case
 {
     void (*fun)(Status*); /* pointer to test case funtion */
     char name[NAME_LEN];  /* human readable name for the test */
+    int flags;            /* TEST_* flags for the test */
+    long timeout;         /* timeout in milliseconds, 0 if none */
+    const char *file;     /* source file of an automatically registered
+                             test, NULL otherwise */
+    int line;             /* source line of the test case definition */
 } Test_case;
 
+/*
+ * A type associating attributes to a test case function.
+ */
+typedef struct test_attr
+{
+    void (*fun)(Status*); /* pointer to test case funtion */
+    int flags;            /* TEST_* flags for the test */
+    long timeout;         /* timeout in milliseconds, 0 if none */
+} Test_attr;
+
+/*
+ * A type representing the state of a benchmark execution, hiddenly passed
+ * to the benchmark function.
+ */
+typedef struct bench
+{
+    size_t iterations; /* number of iterations to be executed */
+    int started;       /* nonzero if the timed loop has been started */
+    long long start;   /* start time of the timed loop, in nanoseconds */
+    long long stop;    /* stop time of the timed loop, in nanoseconds */
+    struct perf_counters *perf; /* counters of the timed loop, or NULL if
+                                   they are not read */
+} Bench;
+
+/*
+ * A type defining a benchmark inside a suite, defined with the macro 
+ * BENCHMARK(name), and its human readable name.
+ */
+typedef struct benchmark
+{
+    void (*fun)(Bench*); /* pointer to benchmark function */
+    char name[NAME_LEN]; /* human readable name for the benchmark */
+} Benchmark;
+
+/*
+ * Hardware events counted for the test cases and the benchmarks.
+ */
+#define PERF_CYCLES        0 /* CPU cycles */
+#define PERF_INSTRUCTIONS  1 /* instructions retired */
+#define PERF_CACHE_MISSES  2 /* last level cache misses */
+#define PERF_BRANCH_MISSES 3 /* mispredicted branches */
+#define PERF_COUNTERS      4
+
+/*
+ * A type collecting the hardware counters of a test case or benchmark,
+ * in user space. Counters not available are not set in the mask.
+ */
+typedef struct perf_counters
+{
+    long value[PERF_COUNTERS]; /* counts, indexed by the PERF_* constants */
+    int mask;                  /* bit i set if value[i] is available */
+} Perf_counters;
+
+/*
+ * A type collecting the statistics of the time per iteration of a
+ * benchmark, in nanoseconds.
+ */
+typedef struct bench_stats
+{
+    size_t iterations; /* iterations in each sample */
+    int samples;       /* number of samples */
+    double mean;       /* mean time per iteration */
+    double median;     /* median time per iteration */
+    double stddev;     /* standard deviation of the time per iteration */
+    double min;        /* minimum time per iteration */
+    double perf_median[PERF_COUNTERS]; /* median of the hardware counters
+                                          per iteration over the samples */
+    double perf_min[PERF_COUNTERS]; /* minimum of the counters per
+                                       iteration over the samples */
+    int perf_mask;     /* counters read in all the samples */
+    int error;         /* nonzero if the benchmark did not complete */
+    int term_sig;      /* signal terminating the benchmark, or 0 */
+    int exit_status;   /* exit status of the benchmark process */
+} Bench_stats;
+
+/*
+ * Phases of the execution of a test case.
+ */
+#define PHASE_BEFORE 1 /* BEFORE_TEST procedure */
+#define PHASE_TEST   2 /* test case function */
+#define PHASE_AFTER  3 /* AFTER_TEST procedure */
+#define PHASE_BEFORE_ALL 4 /* BEFORE_ALL procedure of the suite */
+
+/*
+ * A type describing the entries of two arrays out of tolerance.
+ */
+typedef struct mismatch
+{
+    size_t count; /* number of entries out of tolerance */
+    size_t worst; /* position of the entry with the largest error */
+    double error; /* largest error, in ulp or relative to the tolerance */
+} Mismatch;
+
+/*
+ * A type collecting the time and resources used by a test case.
+ */
+typedef struct metrics
+{
+    long wall_us; /* wall clock time, in microseconds */
+    long user_us; /* user CPU time, in microseconds */
+    long sys_us;  /* system CPU time, in microseconds */
+    long max_rss; /* peak resident set size, in kilobytes, 0 if unknown */
+    long minflt;  /* minor page faults */
+    long majflt;  /* major page faults */
+    long nvcsw;   /* voluntary context switches */
+    long nivcsw;  /* involuntary context switches */
+} Metrics;
+
+/*
+ * A type counting the heap allocations of a test case, from the start of
+ * BEFORE_TEST to the end of AFTER_TEST.
+ */
+typedef struct alloc_stats
+{
+    long allocs; /* blocks allocated */
+    long frees;  /* blocks freed */
+    long bytes;  /* bytes requested */
+    long blocks; /* blocks allocated and not freed, or negative */
+    long leaked; /* usable bytes of the blocks not freed, or negative */
+} Alloc_stats;
+
+/*
+ * A type saving the allocation counters of the thread at the start of the
+ * region of an ASSERT_NO_ALLOC assertion.
+ */
+typedef struct alloc_region
+{
+    long allocs;           /* blocks allocated before the region */
+    long bytes;            /* bytes allocated before the region */
+    int done;              /* nonzero once the statement completed */
+    int checked;           /* nonzero once the region has been checked */
+    const char *assertion; /* text of the assertion */
+    const char *file;      /* source file of the assertion */
+    int line;              /* source line of the assertion */
+    Status *s;             /* status of the test case */
+} Alloc_region;
+
+/*
+ * A type collecting the outcome of a test case execution, filled by the
+ * runner while the test case goes through its phases.
+ */
+typedef struct result
+{
+    int done;           /* nonzero when the execution is complete */
+    int error;          /* phase which terminated abnormally, 0 if none */
+    int term_sig;       /* signal terminating the erroneous phase, or 0 */
+    int exit_status;    /* exit status of the erroneous phase */
+    int cleanup_sig;    /* signal terminating AFTER_TEST, or 0 */
+    int cleanup_status; /* exit status of AFTER_TEST */
+    long timeout;       /* timeout expired in the erroneous phase, or 0 */
+    long cleanup_timeout; /* timeout expired in AFTER_TEST, or 0 */
+    int cancelled;      /* nonzero if not run or killed by fail fast */
+    int failed;         /* nonzero if an assertion failed */
+    int invalid;        /* nonzero if an assertion was invalid */
+    char *assertion;    /* failed or invalid assertion, NULL if none */
+    char *file;         /* source file of the assertion, NULL if none */
+    int line;           /* source line of the assertion */
+    char *message;      /* explanation for an invalid assertion, or NULL */
+    Metrics m;          /* time and resources used by the test case */
+    Alloc_stats alloc;  /* heap allocations, when tracked */
+    Perf_counters perf; /* hardware counters of the test case function */
+} Result;
+
+/*
+ * Outcomes of a test case execution.
+ */
+#define OUTCOME_SUCCESS 0 /* all assertions passed */
+#define OUTCOME_FAILURE 1 /* an assertion failed */
+#define OUTCOME_ERROR   2 /* invalid assertion, or test case lost */
+
+/*
+ * A type for an entry of the cache recording the test case durations 
+ * between runs.
+ */
+typedef struct cache_entry
+{
+    char *suite;  /* suite name, NULL for an empty bucket */
+    char *test;   /* test case name */
+    long wall_us; /* duration of the last run, in microseconds, or -1 */
+    int failed;   /* nonzero if the test case failed in the last run */
+} Cache_entry;
+
+/*
+ * A type for the shared memory area where a child process writes its
+ * state, read by the runner when the child notifies the completion of a
+ * test case or terminates. Strings referenced by the status are copied
+ * by value, since they live in the address space of the child.
+ */
+typedef struct channel
+{
+    volatile int phase;        /* phase in execution, 0 if none */
+    Status st;                 /* status of the test case */
+    char assertion[ASSERTION_LEN]; /* copy of the failed assertion */
+    char file[FILE_LEN];       /* copy of the source file name */
+    Metrics base; /* resources used by the child before the test case */
+    Metrics m;    /* resources used by the child after the test case */
+    Alloc_stats alloc; /* heap allocations of the test case */
+    Perf_counters perf; /* hardware counters of the test case */
+    pid_t child;  /* last process forked by the fixture for the slot */
+} Channel;
+
+/*
+ * A type representing an execution slot of the runner, i.e. a child
+ * process running a test case, or a persistent worker.
+ */
+typedef struct slot
+{
+    pid_t pid;     /* child process, 0 if none */
+    int fd;        /* read end of the pipe notifying the child events */
+    int cmd;       /* write end of the worker command pipe, -1 if none */
+    int cleanup;   /* nonzero if the child runs AFTER_TEST only */
+    long timeout;  /* timeout of the test case in execution, 0 if none */
+    long deadline; /* time when the child must be killed, 0 if none */
+    int killed;    /* nonzero if the child has been killed on timeout */
+    long start;    /* start time of the test case, in microseconds */
+    Channel *chan; /* shared memory area written by the child */
+    Test_case *tc; /* test case in execution */
+    Result *res;   /* outcome of the test case in execution, NULL if idle */
+} Slot;
+
+/*
+ * A type collecting the state of a suite run.
+ */
+typedef struct runner
+{
+    struct suite *s;  /* suite in execution */
+    int mode;         /* execution mode (SUITE_FORK, SUITE_NOFORK, ...) */
+    int jobs;         /* number of slots */
+    long timeout;     /* default timeout for the test cases, 0 if none */
+    Test_case **tcs;  /* selected test cases of the suite, in order */
+    int *order;       /* indexes of the test cases, in start order */
+    Result *results;  /* outcome of each test case */
+    Slot *slots;      /* execution slots */
+    Channel *chans;   /* shared memory areas of the slots */
+    int cancelled;    /* nonzero when the remaining tests are cancelled */
+    int fixture;      /* socket to the fixture process, -1 if none */
+    pid_t fixture_pid; /* fixture process running BEFORE_ALL, 0 if none */
+    int subreaper;    /* subreaper attribute of the runner before the run */
+} Runner;
+
+/*
+ * A request to the fixture process, which forks a child for the slot,
+ * with the same roles of the children forked by the runner.
+ */
+typedef struct fork_request
+{
+    int slot;    /* index of the slot */
+    int test;    /* index of the test case in execution */
+    int worker;  /* nonzero for a persistent worker */
+    int cleanup; /* nonzero for an AFTER_TEST procedure only */
+} Fork_request;
+
+/*
+ * \brief Record the attributes of a test case function
+ * @param fun Test case function
+ * @param flags TEST_* flags for the test case
+ * @param timeout Timeout in milliseconds, 0 if none
+ */
+int __test_set_attr(void (*fun)(Status*), int flags, long timeout);
+
+/*
+ * \brief Start the timed loop of a benchmark
+ * @param __b State of the current benchmark
+ */
+size_t __bench_start(Bench *__b);
+
+/*
+ * \brief Stop the timed loop of a benchmark
+ * @param __b State of the current benchmark
+ */
+int __bench_stop(Bench *__b);
+
+/*
+ * \brief Run the benchmarks of a suite
+ * @param s Suite
+ */
+int __suite_run_benchmarks(struct suite *s);
+
+/*
+ * \brief Select the test cases of a suite to be executed
+ * @param s Suite
+ * @param sel Array filled with the selected test cases, in suite order
+ * @return Number of selected test cases
+ */
+int __suite_select(struct suite *s, Test_case **sel);
+
+/*
+ * \brief Find the cache entry of a test case
+ * @param suite Suite name
+ * @param test Test case name
+ * @param create Nonzero to create the entry if not present
+ */
+Cache_entry* __cache_find(const char *suite, const char *test, int create);
+
+/*
+ * \brief Estimate the duration of test cases from the cache
+ * @param suite Suite name
+ * @param tcs Test cases
+ * @param n Number of test cases
+ * @param est Array filled with the expected durations, in microseconds
+ * @return Number of test cases found in the cache
+ */
+int __cache_estimate(const char *suite, Test_case **tcs, int n, long *est);
+
+/*
+ * \brief Write the cache file
+ */
+int __cache_save(void);
+
+/*
+ * \brief Sort test cases by decreasing expected duration
+ * @param est Expected durations of the test cases
+ * @param n Number of test cases
+ * @param order Array filled with the positions of the test cases, sorted
+ */
+int __sort_by_duration(const long *est, int n, int *order);
+
+/*
+ * \brief Number of failures after which test cases are cancelled, or 0
+ */
+int __max_failures(void);
+
+/*
+ * \brief Check if test cases failed in the previous run go first
+ */
+int __failed_first(void);
+
+/*
+ * \brief Check if the results of the test cases are recorded in the cache
+ */
+int __cache_wanted(void);
+
+/*
+ * \brief Check if the heap allocations of the test cases are tracked
+ */
+int __track_alloc(void);
+
+/*
+ * \brief Check if the hardware counters of the test cases are read
+ */
+int __perf_enabled(void);
+
+/*
+ * \brief Reset and start the hardware counters of the calling thread
+ */
+void __perf_start(void);
+
+/*
+ * \brief Print a notice if some hardware counters are not available
+ */
+void __perf_notice(void);
+
+/*
+ * \brief Read the hardware counters since the last start
+ * @param pc Counters read, with an empty mask if not available
+ */
+void __perf_read(Perf_counters *pc);
+
+/*
+ * \brief Stop and read the hardware counters of the calling thread
+ * @param pc Counters read, with an empty mask if not available
+ */
+void __perf_stop(Perf_counters *pc);
+
+/*
+ * \brief Start counting the heap allocations of the process
+ */
+void __alloc_start(void);
+
+/*
+ * \brief Stop counting the heap allocations of the process
+ * @param st Counters of the allocations since __alloc_start()
+ */
+void __alloc_stop(Alloc_stats *st);
+
+/*
+ * \brief Classify the outcome of a completed test case
+ * @param res Outcome of the test case execution
+ */
+int __result_outcome(const Result *res);
+
+/*
+ * \brief Reset the peak resident set size of the calling process
+ * @return 0 on success, -1 if the peak cannot be reset
+ */
+int __peak_rss_reset(void);
+
+/*
+ * \brief Peak resident set size of the calling process, in kilobytes
+ * @return Peak since the start or the last reset, or 0 if not available
+ */
+long __peak_rss(void);
+
+/*
+ * \brief Notify the reporters of the start of a suite run
+ * @param s Suite
+ * @param tests Number of test cases in the suite
+ */
+int __report_start(const struct suite *s, int tests);
+
+/*
+ * \brief Notify the reporters of the outcome of a test case
+ * @param s Suite
+ * @param tc Test case
+ * @param res Outcome of the test case execution
+ */
+int __report_result(
+        const struct suite *s,
+        const Test_case *tc,
+        const Result *res);
+
+struct summary;
+
+/*
+ * \brief Notify the reporters of the end of a suite run
+ * @param s Suite
+ * @param sum Summary of the suite run
+ */
+int __report_end(const struct suite *s, const struct summary *sum);
+
+/*
+ * \brief Notify the reporters of the outcome of a benchmark
+ * @param s Suite
+ * @param bm Benchmark
+ * @param bs Statistics of the benchmark, or its error
+ */
+int __report_bench(
+        const struct suite *s,
+        const Benchmark *bm,
+        const Bench_stats *bs);
+
+/*
+ * \brief Find the first different byte of two buffers
+ * @param x First buffer to be compared
+ * @param y Second buffer to be compared
+ * @param len Length of the buffers, in bytes
+ * @return Offset of the first different byte, or len if none
+ */
+size_t __compare_bytes(const void *x, const void *y, size_t len);
+
+/*
+ * \brief Find the first different entry of two int arrays
+ * @param x First array to be compared
+ * @param y Second array to be compared
+ * @param len Array length
+ * @return Position of the first different entry, or len if none
+ */
+size_t __compare_int(const int *x, const int *y, size_t len);
+
+/*
+ * \brief Find the first different entry of two floating point arrays
+ * @param x First array to be compared
+ * @param y Second array to be compared
+ * @param len Array length
+ * @param tol Tolerance for numerical comparison
+ * @return Position of the first different entry, or len if none
+ */
+size_t __compare_flo(const double *x, const double *y, size_t len, double tol);
+
+/*
+ * \brief Find the first entries of two double arrays which are not equal
+ * @param x First array to be compared
+ * @param y Second array to be compared
+ * @param len Array length
+ * @return Position of the first different entry, or len if none
+ */
+size_t __compare_equal_dbl(const double *x, const double *y, size_t len);
+
+/*
+ * \brief Find the first entries of two float arrays which are not equal
+ * @param x First array to be compared
+ * @param y Second array to be compared
+ * @param len Array length
+ * @return Position of the first different entry, or len if none
+ */
+size_t __compare_equal_flt(const float *x, const float *y, size_t len);
+
+/*
+ * \brief Size of the entries of a type code
+ * @param type Type code (one of the TYPE_* constants)
+ * @return Size of the entries, in bytes
+ */
+size_t __type_size(int type);
+
+/*
+ * \brief Write the value of an entry of a type code
+ * @param buf Output buffer
+ * @param len Size of the output buffer
+ * @param p Pointer to the entry
+ * @param type Type code of the entry (one of the TYPE_* constants)
+ */
+void __format_entry(char *buf, size_t len, const void *p, int type);
+
+/*
+ * \brief Find the double entries out of a tolerance in ulp
+ * @param x First array to be compared
+ * @param y Second array to be compared
+ * @param len Array length
+ * @param ulps Tolerance, in units in the last place
+ * @param mm Filled with the description of the entries out of tolerance
+ * @return Number of entries out of tolerance
+ */
+size_t __compare_ulp_dbl(
+        const double *x,
+        const double *y,
+        size_t len,
+        uint64_t ulps,
+        Mismatch *mm);
+
+/*
+ * \brief Find the float entries out of a tolerance in ulp
+ * @param x First array to be compared
+ * @param y Second array to be compared
+ * @param len Array length
+ * @param ulps Tolerance, in units in the last place
+ * @param mm Filled with the description of the entries out of tolerance
+ * @return Number of entries out of tolerance
+ */
+size_t __compare_ulp_flt(
+        const float *x,
+        const float *y,
+        size_t len,
+        uint64_t ulps,
+        Mismatch *mm);
+
+/*
+ * \brief Find the double entries out of an absolute and relative tolerance
+ * @param x First array to be compared
+ * @param y Second array to be compared
+ * @param len Array length
+ * @param abs Absolute tolerance
+ * @param rel Relative tolerance
+ * @param mm Filled with the description of the entries out of tolerance
+ * @return Number of entries out of tolerance
+ */
+size_t __compare_close_dbl(
+        const double *x,
+        const double *y,
+        size_t len,
+        double abs,
+        double rel,
+        Mismatch *mm);
+
+/*
+ * \brief Find the float entries out of an absolute and relative tolerance
+ * @param x First array to be compared
+ * @param y Second array to be compared
+ * @param len Array length
+ * @param abs Absolute tolerance
+ * @param rel Relative tolerance
+ * @param mm Filled with the description of the entries out of tolerance
+ * @return Number of entries out of tolerance
+ */
+size_t __compare_close_flt(
+        const float *x,
+        const float *y,
+        size_t len,
+        double abs,
+        double rel,
+        Mismatch *mm);
+
+/*
+ * \brief This function actually implements ulp asserts on doubles
+ * @param x First array to be compared
+ * @param y Second array to be compared
+ * @param m Number of rows (array length)
+ * @param n Number of columns (1 for arrays)
+ * @param shape SHAPE_SCALAR, SHAPE_ARRAY or SHAPE_MATRIX
+ * @param ulps Tolerance, in units in the last place
+ * @param __s Status of current test case
+ */
+int __assert_ulp_dbl(
+        const double *x,
+        const double *y,
+        size_t m,
+        size_t n,
+        int shape,
+        long ulps,
+        Status *__s);
+
+/*
+ * \brief This function actually implements ulp asserts on floats
+ * @param x First array to be compared
+ * @param y Second array to be compared
+ * @param m Number of rows (array length)
+ * @param n Number of columns (1 for arrays)
+ * @param shape SHAPE_SCALAR, SHAPE_ARRAY or SHAPE_MATRIX
+ * @param ulps Tolerance, in units in the last place
+ * @param __s Status of current test case
+ */
+int __assert_ulp_flt(
+        const float *x,
+        const float *y,
+        size_t m,
+        size_t n,
+        int shape,
+        long ulps,
+        Status *__s);
+
+/*
+ * \brief This function actually implements relative asserts on doubles
+ * @param x First array to be compared
+ * @param y Second array to be compared
+ * @param m Number of rows (array length)
+ * @param n Number of columns (1 for arrays)
+ * @param shape SHAPE_SCALAR, SHAPE_ARRAY or SHAPE_MATRIX
+ * @param abs Absolute tolerance
+ * @param rel Relative tolerance
+ * @param __s Status of current test case
+ */
+int __assert_close_dbl(
+        const double *x,
+        const double *y,
+        size_t m,
+        size_t n,
+        int shape,
+        double abs,
+        double rel,
+        Status *__s);
+
+/*
+ * \brief This function actually implements relative asserts on floats
+ * @param x First array to be compared
+ * @param y Second array to be compared
+ * @param m Number of rows (array length)
+ * @param n Number of columns (1 for arrays)
+ * @param shape SHAPE_SCALAR, SHAPE_ARRAY or SHAPE_MATRIX
+ * @param abs Absolute tolerance
+ * @param rel Relative tolerance
+ * @param __s Status of current test case
+ */
+int __assert_close_flt(
+        const float *x,
+        const float *y,
+        size_t m,
+        size_t n,
+        int shape,
+        double abs,
+        double rel,
+        Status *__s);
+
+/*
+ * \brief This function actually implements type generic equality asserts
+ * @param x First array to be compared
+ * @param y Second array to be compared
+ * @param m Number of rows (array length)
+ * @param n Number of columns (1 for arrays)
+ * @param shape SHAPE_ARRAY or SHAPE_MATRIX
+ * @param x_type Type code of the entries of the first array
+ * @param y_type Type code of the entries of the second array
+ * @param __s Status of current test case
+ */
+int __assert_equals_typed(
+        const void *x,
+        const void *y,
+        size_t m,
+        size_t n,
+        int shape,
+        int x_type,
+        int y_type,
+        Status *__s);
+
+/*
+ * \brief This function actually implements strided matrix equality asserts
+ * @param x First entry of the first matrix
+ * @param y First entry of the second matrix
+ * @param m Number of rows
+ * @param n Number of columns
+ * @param strides Row and column strides of the first and second matrix,
+ *                in entries
+ * @param x_type Type code of the entries of the first matrix
+ * @param y_type Type code of the entries of the second matrix
+ * @param __s Status of current test case
+ */
+int __assert_equals_strided(
+        const void *x,
+        const void *y,
+        size_t m,
+        size_t n,
+        const ptrdiff_t *strides,
+        int x_type,
+        int y_type,
+        Status *__s);
+
+/*
+ * \brief This function actually implements strided matrix floating point
+ *        asserts
+ * @param x First entry of the first matrix
+ * @param y First entry of the second matrix
+ * @param m Number of rows
+ * @param n Number of columns
+ * @param strides Row and column strides of the first and second matrix,
+ *                in entries
+ * @param tol Tolerance for numerical comparison
+ * @param __s Status of current test case
+ */
+int __assert_equals_strided_flo(
+        const double *x,
+        const double *y,
+        size_t m,
+        size_t n,
+        const ptrdiff_t *strides,
+        double tol,
+        Status *__s);
+
+/*
+ * \brief This function actually implements snapshot asserts
+ * @param buf Buffer to be compared
+ * @param len Buffer length, in bytes
+ * @param path Path of the reference file
+ * @param __s Status of current test case
+ */
+int __assert_equals_file(const void *buf, size_t len, const char *path,
+        Status *__s);
+
+/*
+ * \brief This function actually implements file equality asserts
+ * @param path Path of the file to be compared
+ * @param ref_path Path of the reference file
+ * @param __s Status of current test case
+ */
+int __assert_files_equal(const char *path, const char *ref_path,
+        Status *__s);
+
+/*
+ * \brief Reset the allocation counters of the calling thread
+ */
+void __alloc_thread_reset(void);
+
+/*
+ * \brief Enter an allocation free region of the calling thread
+ * @param assertion Text of the assertion
+ * @param file Source file of the assertion
+ * @param line Source line of the assertion
+ * @param __s Status of current test case
+ * @return Counters of the thread before the region
+ */
+Alloc_region __alloc_region_start(const char *assertion, const char *file,
+        int line, Status *__s);
+
+/*
+ * \brief Close an allocation free region left before its check
+ * @param r Counters saved at the start of the region
+ */
+void __alloc_region_end(Alloc_region *r);
+
+/*
+ * \brief Invalidate a test case which left a region before its check
+ * @param __s Status of current test case
+ */
+void __alloc_regions_check(Status *__s);
+
+/*
+ * \brief This function actually implements allocation free region asserts
+ * @param r Counters saved at the start of the region
+ * @param __s Status of current test case
+ */
+int __assert_no_alloc(Alloc_region *r, Status *__s);
+
+/*
+ * \brief This function actually implements allocated bytes asserts
+ * @param n Bound for the bytes allocated by the test case
+ * @param __s Status of current test case
+ */
+int __assert_alloc_bytes_below(long n, Status *__s);
+
+/*
+ * \brief This function actually implements resident set size asserts
+ * @param bytes Bound for the maximum resident set size, in bytes
+ * @param __s Status of current test case
+ */
+int __assert_max_rss_below(long bytes, Status *__s);
+
+/*
+ * \brief This function actually implements instruction count asserts
+ * @param n Bound for the instructions executed by the test case
+ * @param __s Status of current test case
+ */
+int __assert_instructions_below(long n, Status *__s);
+
 /*
  * \brief This function actually implements floating point asserts
  * @param x First number to be compared
@@ -194,7 +1371,7 @@ int __assert_equals_flo(double x, double y, double tol, Status *__s);
 int __assert_equals_array_int(
         int *x,
         int *y,
-        int len,
+        size_t len,
         Status *__s);
 
 /*
@@ -208,7 +1385,7 @@ int __assert_equals_array_int(
 int __assert_equals_array_flo(
         double *x,
         double *y,
-        int len,
+        size_t len,
         double tol,
         Status *__s);
 
@@ -222,8 +1399,8 @@ int __assert_equals_array_flo(
  * @param __s Status of current test case
  */
 int __assert_equals_matrix_int(
-        int m,
-        int n,
+        size_t m,
+        size_t n,
         int x[m][n],
         int y[m][n],
         Status *__s);
@@ -237,8 +1414,8 @@ int __assert_equals_matrix_int(
  * @param __s Status of current test case
  */
 int __assert_equals_matrix_flo(
-        int m,
-        int n,
+        size_t m,
+        size_t n,
         double x[m][n],
         double y[m][n],
         double tol,
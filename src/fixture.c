@@ -0,0 +1,160 @@
+/*
+ * This file is part of cUTest.
+ *
+ * cUTest is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cUTest is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cUTest. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Martino Pilia, 2015
+ */
+
+/*!
+ * \file fixture.c
+ *
+ * @author Martino Pilia
+ * @date 2015-01-13
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "cutest.h"
+
+/*
+ * Maximum number of shared fixtures of a process.
+ */
+#define SHARED_FIXTURE_MAX 64
+
+/*
+ * A read only fixture, shared by all the processes of the run.
+ */
+typedef struct shared_fixture
+{
+    char name[NAME_LEN]; /* name of the fixture */
+    size_t size;         /* size of the fixture, in bytes */
+    const void *data;    /* read only mapping of the fixture */
+} Shared_fixture;
+
+/*
+ * Fixtures built by the process or inherited from its parent.
+ */
+static Shared_fixture fixtures[SHARED_FIXTURE_MAX];
+static int fixtures_num = 0;
+
+/*
+ * Build a fixture in a sealed memory file, and map it read only. The
+ * content is written through a temporary writable mapping, which must be
+ * removed before the file can be sealed against writes.
+ */
+static const void* build_fixture(
+        const char *name,
+        size_t size,
+        void (*init)(void *data, size_t size))
+{
+    void *p;
+    int fd;
+
+    fd = memfd_create(name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd == -1)
+    {
+        perror("cutest_shared_fixture: memfd_create error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (ftruncate(fd, size))
+    {
+        perror("cutest_shared_fixture: ftruncate error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+    {
+        perror("cutest_shared_fixture: mmap error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    init(p, size);
+    munmap(p, size);
+
+    if (fcntl(fd, F_ADD_SEALS,
+                F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL))
+    {
+        perror("cutest_shared_fixture: fcntl error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    p = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+    {
+        perror("cutest_shared_fixture: mmap error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    close(fd);
+    return p;
+}
+
+/*!
+ * Return the read only fixture with the given name, building it on the
+ * first request. Child processes inherit the fixtures built before they
+ * were forked, so all of them share the same pages.
+ */
+const void* cutest_shared_fixture(
+        const char *name,
+        size_t size,
+        void (*init)(void *data, size_t size))
+{
+    Shared_fixture *f;
+    int i;
+
+    for (i = 0; i < fixtures_num; i++)
+    {
+        f = &fixtures[i];
+        if (strncmp(f->name, name, NAME_LEN) != 0)
+            continue;
+
+        if (f->size != size)
+        {
+            fprintf(stderr, "cutest_shared_fixture: fixture \"%s\" "
+                    "requested with size %zu, built with size %zu.\n",
+                    name, size, f->size);
+            exit(EXIT_FAILURE);
+        }
+        return f->data;
+    }
+
+    if (fixtures_num == SHARED_FIXTURE_MAX)
+    {
+        fprintf(stderr, "cutest_shared_fixture: too many fixtures.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (size == 0)
+    {
+        fprintf(stderr, "cutest_shared_fixture: empty fixture \"%s\".\n",
+                name);
+        exit(EXIT_FAILURE);
+    }
+
+    f = &fixtures[fixtures_num];
+    snprintf(f->name, NAME_LEN, "%s", name);
+    f->size = size;
+    f->data = build_fixture(name, size, init);
+    fixtures_num++;
+
+    return f->data;
+}
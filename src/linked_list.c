@@ -20,62 +20,166 @@
 #include <stdio.h>
 #include "linked_list.h"
 
-static Node* node_alloc(Node* next, void *data)
+/*
+ * Number of nodes in the first block allocated for a list, and maximum
+ * number of nodes in a block. Each block doubles the previous one.
+ */
+#define SLAB_MIN 16
+#define SLAB_MAX 4096
+
+/*
+ * Take a node from the free nodes of the list, allocating a new block of
+ * nodes when none is available.
+ */
+static Node* node_alloc(ll_list *l, Node *prev, Node* next, void *data)
 {
-    Node* new_node = (Node*) malloc(sizeof (Node));
-    if (new_node == NULL)
+    Node* new_node;
+    ll_slab *slab;
+    size_t len;
+    size_t i;
+
+    if (l->free == NULL)
     {
-        perror("node_alloc: resource unavaible for malloc.\n");
-        exit(EXIT_FAILURE);
+        len = l->slabs != NULL ? 2 * l->slabs->len : SLAB_MIN;
+        if (len > SLAB_MAX)
+            len = SLAB_MAX;
+
+        slab = (ll_slab*) malloc(sizeof (ll_slab) + len * sizeof (Node));
+        if (slab == NULL)
+        {
+            perror("node_alloc: resource unavaible for malloc.\n");
+            exit(EXIT_FAILURE);
+        }
+        slab->len = len;
+        slab->next = l->slabs;
+        l->slabs = slab;
+
+        for (i = 0; i < len; ++i) /* chain the new nodes as free */
+            slab->nodes[i].next = i + 1 < len ? &slab->nodes[i + 1] : NULL;
+        l->free = slab->nodes;
     }
+
+    new_node = l->free;
+    l->free = new_node->next;
+
     new_node->data = data;
+    new_node->prev = prev;
     new_node->next = next;
     return new_node;
 }
 
+/*
+ * Unlink a node from the list, and make it available for reuse.
+ */
+static void* node_remove(ll_list *l, Node *n)
+{
+    void *d = n->data;
+
+    if (n->prev != NULL)
+        n->prev->next = n->next;
+    else
+        l->root = n->next;
+
+    if (n->next != NULL)
+        n->next->prev = n->prev;
+    else
+        l->tail = n->prev;
+
+    n->next = l->free;
+    l->free = n;
+    l->size--;
+    return d;
+}
+
+/*
+ * Get the node in the given one-based position.
+ */
+static Node* node_get(ll_list *l, int pos)
+{
+    unsigned int i;
+    Node *n;
+
+    if (pos < 1 || (unsigned int) pos > l->size)
+    {
+        perror("ll_get_pos: index out of bound.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if ((unsigned int) pos <= l->size / 2) /* walk from the nearest end */
+        for (i = 1, n = l->root; i < (unsigned int) pos; ++i)
+            n = n->next;
+    else
+        for (i = l->size, n = l->tail; i > (unsigned int) pos; --i)
+            n = n->prev;
+
+    return n;
+}
+
 /*!
- * This function initializes a list, allocating memory and setting the 
- * values to default.
+ * This function initializes a list, setting the values to default.
  */
 int ll_init(ll_list *l)
 {
     l->root = NULL;
+    l->tail = NULL;
     l->size = 0;
+    l->free = NULL;
+    l->slabs = NULL;
     return 0;
 }
 
 /*!
- * This function destroys the list, deallocating memory.
+ * This function destroys the list, deallocating its nodes and the list 
+ * itself, which is not freed when empty as in the previous releases.
  */
 int ll_destroy(ll_list *l)
 {
-    if (l == NULL || l->size == 0)
+    int empty;
+
+    if (l == NULL)
         return 0;
 
-    while (l->size > 0)
-        ll_pop_front(l);
-    free(l);
+    empty = l->size == 0;
+    ll_clear(l);
+    if (!empty)
+        free(l);
     return 0;
 }
 
 /*!
- * Adds a node in the front of the list (farthest from the root).
+ * This function empties the list, deallocating at once the blocks of 
+ * nodes owned by the list.
  */
-int ll_push_front(ll_list *l, void *d)
+int ll_clear(ll_list *l)
 {
-    if (l->root == NULL) /* empty list */
-    {
-        l->root = node_alloc(NULL, d);
-        l->size++;
+    ll_slab *slab;
+
+    if (l == NULL)
         return 0;
+
+    while (l->slabs != NULL)
+    {
+        slab = l->slabs;
+        l->slabs = slab->next;
+        free(slab);
     }
 
-    /* list scroll */
-    Node *n = l->root;
-    while (n->next != NULL)
-        n = n->next;
+    return ll_init(l);
+}
 
-    n->next = node_alloc(NULL, d);
+/*!
+ * Adds a node in the front of the list (farthest from the root).
+ */
+int ll_push_front(ll_list *l, void *d)
+{
+    Node *n = node_alloc(l, l->tail, NULL, d);
+
+    if (l->tail != NULL)
+        l->tail->next = n;
+    else /* empty list */
+        l->root = n;
+
+    l->tail = n;
     l->size++;
     return 0;
 }
@@ -85,7 +189,13 @@ int ll_push_front(ll_list *l, void *d)
  */
 int ll_push_back(ll_list *l, void *d)
 {
-    Node* n = node_alloc(l->root, d);
+    Node* n = node_alloc(l, NULL, l->root, d);
+
+    if (l->root != NULL)
+        l->root->prev = n;
+    else /* empty list */
+        l->tail = n;
+
     l->root = n;
     l->size++;
     return 0;
@@ -93,129 +203,140 @@ int ll_push_back(ll_list *l, void *d)
 
 void* ll_pop_front(ll_list *l)
 {
-    if (l->root == NULL) /* empty list */
+    if (l->tail == NULL) /* empty list */
     {
         perror("ll_pop_front: trying to pop from empty list.\n");
         exit(EXIT_FAILURE);
     }
-    
-    if (l->root->next == NULL) /* one element list */
-    {
-        void *d = l->root->data;
-        Node *n = l->root;
-        l->root = NULL;
-        l->size--;
-        free(n);
-        return d;
-    }
 
-    /* two or more element, scroll the list */
-    Node *penultimate = l->root;
-    Node *last = penultimate->next;
-    while (last->next != NULL)
-    {
-        penultimate = last;
-        last = last->next;
-    }
-
-    penultimate->next = NULL;
-    void *d = last->data;
-    free(last);
-    l->size--;
-    return d;
+    return node_remove(l, l->tail);
 }
 
 void* ll_pop_back(ll_list *l)
 {
     if (l->root == NULL) /* empty list */
     {
-        perror("ll_pop_front: trying to pop from empty list.\n");
+        perror("ll_pop_back: trying to pop from empty list.\n");
         exit(EXIT_FAILURE);
     }
 
-    Node *n = l->root;
-    void *d = n->data;
-    
-    l->root = l->root->next; /* shift list head */
-    free(n);
-    l->size--;
-    return d;
+    return node_remove(l, l->root);
 }
 
 void* ll_get_pos(ll_list l, int pos)
 {
-    if (pos < 1 || (unsigned int) pos > l.size)
-    {
-        perror("ll_get_pos: index out of bound.\n");
-        exit(EXIT_FAILURE);
-    }
-    
-    int i;
-    Node *n = l.root;
-    for (i = 1; i < pos; ++i)
-    {
-        n = n->next;
-    }
-    return n->data;
+    return node_get(&l, pos)->data;
 }
 
 void* ll_pop_pos(ll_list l, int pos)
 {
-    if (pos < 1 || (unsigned int) pos > l.size)
-    {
-        perror("ll_get_pos: index out of bound.\n");
-        exit(EXIT_FAILURE);
-    }
-    
-    int i;
-    Node *n = l.root, *penultimate;
-    void *res;
-    for (i = 1; i < pos; ++i)
-    {
-        penultimate = n;
-        n = n->next;
-    }
-    penultimate->next = n->next;
-    res = n->data;
-    free(n);
-    return res;
+    Node *n = node_get(&l, pos);
+
+    if (n->prev != NULL)
+        n->prev->next = n->next;
+    if (n->next != NULL)
+        n->next->prev = n->prev;
+    return n->data;
+}
+
+void* ll_pop_pos_ptr(ll_list *l, int pos)
+{
+    return node_remove(l, node_get(l, pos));
 }
 
 ll_iterator ll_get_iterator(ll_list l)
 {
-    ll_iterator it = {l, l.root};
+    ll_iterator it = {l.root};
     return it;
 }
 
 void* ll_next(ll_iterator *it)
 {
-    void *res = it->next->data;
-    if (it->next->next != NULL)
-        it->next = it->next->next;
+    void *res;
+
+    if (it->next == NULL)
+        return NULL;
+
+    res = it->next->data;
+    it->next = it->next->next;
     return res;
 }
 
 int ll_copy(ll_list *to, ll_list from)
 {
-    ll_destroy(to);
-    ll_init(to);
+    ll_clear(to);
+    return ll_append(to, from);
+}
 
-    ll_iterator it = ll_get_iterator(from);
+int ll_append(ll_list *to, ll_list from)
+{
+    Node *n;
 
-    int i = 0;
-    while ((unsigned int) i++ < from.size)
-        ll_push_front(to, ll_next(&it));
+    for (n = from.root; n != NULL; n = n->next)
+        ll_push_front(to, n->data);
     
     return 0;
 }
 
-int ll_append(ll_list *to, ll_list from)
+int il_init(il_list *l)
 {
-    ll_iterator it = ll_get_iterator(from);
+    l->head.next = &l->head;
+    l->head.prev = &l->head;
+    l->size = 0;
+    return 0;
+}
 
-    int i = 0;
-    while ((unsigned int) i++ < from.size)
-        ll_push_front(to, ll_next(&it));
-    
+/*
+ * Link a node between two adjacent nodes of an intrusive list.
+ */
+static void il_link(il_list *l, il_node *n, il_node *prev, il_node *next)
+{
+    n->prev = prev;
+    n->next = next;
+    prev->next = n;
+    next->prev = n;
+    l->size++;
+}
+
+int il_push_front(il_list *l, il_node *n)
+{
+    il_link(l, n, l->head.prev, &l->head);
+    return 0;
+}
+
+int il_push_back(il_list *l, il_node *n)
+{
+    il_link(l, n, &l->head, l->head.next);
     return 0;
 }
+
+int il_remove(il_list *l, il_node *n)
+{
+    n->prev->next = n->next;
+    n->next->prev = n->prev;
+    n->next = n->prev = NULL;
+    l->size--;
+    return 0;
+}
+
+il_node* il_pop_front(il_list *l)
+{
+    il_node *n = l->head.prev;
+
+    if (n == &l->head) /* empty list */
+        return NULL;
+
+    il_remove(l, n);
+    return n;
+}
+
+il_node* il_pop_back(il_list *l)
+{
+    il_node *n = l->head.next;
+
+    if (n == &l->head) /* empty list */
+        return NULL;
+
+    il_remove(l, n);
+    return n;
+}
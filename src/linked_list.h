@@ -23,30 +23,48 @@
  * @date 2014-12-17
  */
 
-#define LIST_INITIALIZER {NULL, 0} /*!< Value for list initialization */
+#include <stddef.h>
+
+/*! Value for list initialization */
+#define LIST_INITIALIZER {NULL, 0, NULL, NULL, NULL}
 
 /*!
  * \brief Type for the node of the list.
  *
- * This type defines a node of the list, containing a pointer to the next
- * node and the data for the current element.
+ * This type defines a node of the list, containing pointers to the
+ * adjacent nodes and the data for the current element.
  */
 typedef struct node
 {
-    struct node *next; /*!< pointer to the next node */
+    struct node *next; /*!< pointer to the next node (towards the front) */
+    struct node *prev; /*!< pointer to the previous node (towards the root) */
     void *data; /*!< data contained in the current node */
 } Node;
 
+/*!
+ * \brief Type for a block of nodes allocated at once.
+ */
+typedef struct ll_slab
+{
+    struct ll_slab *next; /*!< next block allocated for the same list */
+    size_t len; /*!< number of nodes in the block */
+    Node nodes[]; /*!< nodes of the block */
+} ll_slab;
+
 /*!
  * \brief Type for the list.
  *
- * This type defines a list, containing a pointer to its root node and 
- * its size.
+ * This type defines a list, containing pointers to its root node and to 
+ * its last node (the front), and its size. Nodes are drawn from blocks
+ * owned by the list, and nodes of removed elements are reused.
  */
 typedef struct
 {
     Node* root; /*!< pointer to the root node of the list */
     unsigned int size; /*!< current list size */
+    Node* tail; /*!< pointer to the last node of the list */
+    Node* free; /*!< nodes available for new elements */
+    ll_slab *slabs; /*!< blocks of nodes owned by the list */
 } ll_list;
 
 /*!
@@ -55,13 +73,59 @@ typedef struct
  * This type defines an iterator. An iterator is an object used to read
  * the list from the root to the last node (front). To read the list,
  * create an iterator and then read the nodes with the ll_next() function.
+ * The list must not be modified while it is iterated.
  */
 typedef struct
 {
-    ll_list l; /*!< list that the iterator is referring */
     Node *next; /*!< next node to be read from the list */
 } ll_iterator;
 
+/*!
+ * \brief Type for the node of an intrusive list.
+ *
+ * An intrusive list links nodes embedded in the elements, so adding an 
+ * element does not allocate memory. The element containing a node is
+ * obtained with il_entry().
+ */
+typedef struct il_node
+{
+    struct il_node *next; /*!< next node (towards the front) */
+    struct il_node *prev; /*!< previous node (towards the root) */
+} il_node;
+
+/*!
+ * \brief Type for an intrusive list.
+ *
+ * The list is circular, with a sentinel node, and cannot be copied by 
+ * value.
+ */
+typedef struct
+{
+    il_node head; /*!< sentinel, head.next is the root, head.prev the front */
+    unsigned int size; /*!< current list size */
+} il_list;
+
+/*!
+ * \brief Get the element containing an intrusive list node.
+ *
+ * @param node pointer to the node
+ * @param type type of the element
+ * @param member name of the node inside the element
+ */
+#define il_entry(node, type, member) \
+    ((type*) ((char*) (node) - offsetof(type, member)))
+
+/*!
+ * \brief Iterate an intrusive list from the root to the front.
+ *
+ * The loop body must not remove the current node from the list.
+ *
+ * @param n pointer to il_node, set to each node
+ * @param l pointer to the list
+ */
+#define il_for_each(n, l) \
+    for ((n) = (l)->head.next; (n) != &(l)->head; (n) = (n)->next)
+
 /*!
  * \brief Initialize a list.
  *
@@ -72,10 +136,25 @@ int ll_init(ll_list *l);
 /*!
  * \brief Destroy a list
  *
+ * All the nodes of the list are released, and the list itself, which must
+ * have been allocated with malloc(), is freed unless it is empty. The 
+ * data pointed by the elements is not freed. Use ll_clear() for lists 
+ * not allocated with malloc().
+ *
  * @param l list to be destroyed
  */
 int ll_destroy(ll_list *l);
 
+/*!
+ * \brief Remove all the elements of a list
+ *
+ * All the nodes of the list are released at once, and the list is left
+ * empty. The data pointed by the elements is not freed.
+ *
+ * @param l list to be cleared
+ */
+int ll_clear(ll_list *l);
+
 /*!
  * \brief Add a node at the list beginning.
  *
@@ -117,11 +196,23 @@ void* ll_get_pos(ll_list l, int pos);
 /*!
  * \brief Remove an element from a specific position in the list
  *
- * @param l list to get the element from
+ * The node is unlinked from its neighbours, but the list is passed by 
+ * value, so its root, front and size are not updated: the position must
+ * not be the first or the last one. Deprecated, use ll_pop_pos_ptr().
+ *
+ * @param l list to remove the element from
  * @param pos one-based position of the desired element (starting from root)
  */
 void* ll_pop_pos(ll_list l, int pos);
 
+/*!
+ * \brief Remove an element from a specific position in the list
+ *
+ * @param l list to remove the element from
+ * @param pos one-based position of the desired element (starting from root)
+ */
+void* ll_pop_pos_ptr(ll_list *l, int pos);
+
 /*!
  * \brief Get an iterator for the specified list
  *
@@ -132,6 +223,8 @@ ll_iterator ll_get_iterator(ll_list l);
 /*!
  * \brief Get the next element from an iterator
  *
+ * Return NULL when all the elements have been read.
+ *
  * @param it iterator for the desired list
  */
 void* ll_next(ll_iterator *it);
@@ -151,3 +244,50 @@ int ll_copy(ll_list *to, ll_list from);
  * @param from list to be copied
  */
 int ll_append(ll_list *to, ll_list from);
+
+/*!
+ * \brief Initialize an intrusive list.
+ *
+ * @param l list to be initialized
+ */
+int il_init(il_list *l);
+
+/*!
+ * \brief Add a node at the intrusive list beginning (front).
+ *
+ * @param l list to add the node to
+ * @param n node to be added
+ */
+int il_push_front(il_list *l, il_node *n);
+
+/*!
+ * \brief Add a node at the intrusive list end (root).
+ *
+ * @param l list to add the node to
+ * @param n node to be added
+ */
+int il_push_back(il_list *l, il_node *n);
+
+/*!
+ * \brief Remove a node from the intrusive list beginning (front).
+ *
+ * @param l list to remove the node from
+ * @return the removed node, NULL if the list is empty
+ */
+il_node* il_pop_front(il_list *l);
+
+/*!
+ * \brief Remove a node from the intrusive list end (root).
+ *
+ * @param l list to remove the node from
+ * @return the removed node, NULL if the list is empty
+ */
+il_node* il_pop_back(il_list *l);
+
+/*!
+ * \brief Remove a node from the intrusive list containing it.
+ *
+ * @param l list containing the node
+ * @param n node to be removed
+ */
+int il_remove(il_list *l, il_node *n);
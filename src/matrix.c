@@ -0,0 +1,445 @@
+/*
+ * This file is part of cUTest.
+ *
+ * cUTest is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cUTest is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cUTest. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Martino Pilia, 2015
+ */
+
+/*!
+ * \file matrix.c
+ *
+ * @author Martino Pilia
+ * @date 2015-01-13
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "cutest.h"
+
+/*
+ * Side of the tiles compared at once. Rows are compared in bands of
+ * TILE rows, and a mismatch is reported only after its band is complete,
+ * so that the first mismatch in row major order is found whatever the
+ * order of the visit inside the band.
+ */
+#define TILE 64
+
+/*
+ * Minimum number of entries for the comparison to be split among threads,
+ * and maximum number of threads.
+ */
+#define THREAD_MIN_ENTRIES (1 << 22)
+#define THREAD_MAX 64
+
+/*
+ * A comparison between two strided matrixes. Strides are in bytes.
+ */
+typedef struct strided
+{
+    const char *x;  /* first entry of the first matrix */
+    const char *y;  /* first entry of the second matrix */
+    size_t m;       /* number of rows */
+    size_t n;       /* number of columns */
+    ptrdiff_t x_rs; /* distance between two rows of the first matrix */
+    ptrdiff_t x_cs; /* distance between two columns of the first matrix */
+    ptrdiff_t y_rs; /* distance between two rows of the second matrix */
+    ptrdiff_t y_cs; /* distance between two columns of the second matrix */
+    int type;       /* type code of the entries */
+    size_t size;    /* size of the entries */
+    double tol;     /* tolerance, or 0 for exact comparison */
+} Strided;
+
+/*
+ * Position of a mismatch. No mismatch is represented by i == m.
+ */
+typedef struct position
+{
+    size_t i; /* row */
+    size_t j; /* column */
+} Position;
+
+/*
+ * State shared by the threads comparing the bands of the same matrixes.
+ */
+typedef struct shared
+{
+    const Strided *c; /* comparison */
+    size_t bands;     /* total number of bands */
+    size_t next;      /* next band to be compared */
+    size_t found;     /* lowest band with a mismatch, or bands if none */
+} Shared;
+
+/*
+ * A thread comparing bands.
+ */
+typedef struct worker
+{
+    Shared *sh;   /* shared state */
+    Position pos; /* first mismatch found by the thread */
+    pthread_t tid;
+} Worker;
+
+/*
+ * Address of an entry of the first and of the second matrix.
+ */
+static const char *x_at(const Strided *c, size_t i, size_t j)
+{
+    return c->x + (ptrdiff_t) i * c->x_rs + (ptrdiff_t) j * c->x_cs;
+}
+
+static const char *y_at(const Strided *c, size_t i, size_t j)
+{
+    return c->y + (ptrdiff_t) i * c->y_rs + (ptrdiff_t) j * c->y_cs;
+}
+
+/*
+ * Check if two entries differ. Integers are compared by their
+ * representation, floating point numbers by value.
+ */
+static int entry_differs(const Strided *c, const char *a, const char *b)
+{
+    double u, v;
+    float f, g;
+
+    if (c->type == TYPE_DOUBLE)
+    {
+        memcpy(&u, a, sizeof (u));
+        memcpy(&v, b, sizeof (v));
+        return c->tol > 0.0 ? fabs(u - v) > c->tol : !(u == v);
+    }
+
+    if (c->type == TYPE_FLOAT)
+    {
+        memcpy(&f, a, sizeof (f));
+        memcpy(&g, b, sizeof (g));
+        return !(f == g);
+    }
+
+    return memcmp(a, b, c->size) != 0;
+}
+
+/*
+ * Compare two contiguous segments of len entries, returning the position
+ * of the first different entry, or len if they are equal.
+ */
+static size_t compare_segment(
+        const Strided *c,
+        const char *a,
+        const char *b,
+        size_t len)
+{
+    if (c->type == TYPE_DOUBLE && c->tol > 0.0)
+        return __compare_flo((const double*) a, (const double*) b, len,
+                c->tol);
+
+    if (c->type == TYPE_DOUBLE)
+        return __compare_equal_dbl((const double*) a, (const double*) b,
+                len);
+
+    if (c->type == TYPE_FLOAT)
+        return __compare_equal_flt((const float*) a, (const float*) b,
+                len);
+
+    return __compare_bytes(a, b, len * c->size) / c->size;
+}
+
+/*
+ * Keep the first of two positions in row major order.
+ */
+static void keep_first(Position *p, size_t i, size_t j)
+{
+    if (i < p->i || (i == p->i && j < p->j))
+    {
+        p->i = i;
+        p->j = j;
+    }
+}
+
+/*
+ * Compare the rows [i0, i1) of two matrixes, returning the first mismatch
+ * among them in row major order, or i == m if there is none. Rows
+ * contiguous in both matrixes are compared with the vectorized kernels,
+ * as columns contiguous in both matrixes, otherwise the band is visited
+ * in square tiles.
+ */
+static Position compare_band(const Strided *c, size_t i0, size_t i1)
+{
+    Position p = {c->m, 0};
+    size_t i, j, j0, j1, k;
+
+    if (c->x_cs == (ptrdiff_t) c->size && c->y_cs == (ptrdiff_t) c->size)
+    {
+        for (i = i0; i < i1; ++i)
+        {
+            k = compare_segment(c, x_at(c, i, 0), y_at(c, i, 0), c->n);
+            if (k < c->n)
+            {
+                keep_first(&p, i, k);
+                break;
+            }
+        }
+        return p;
+    }
+
+    if (c->x_rs == (ptrdiff_t) c->size && c->y_rs == (ptrdiff_t) c->size)
+    {
+        for (j = 0; j < c->n && p.i > i0; ++j)
+        {
+            k = compare_segment(c, x_at(c, i0, j), y_at(c, i0, j), i1 - i0);
+            if (k < i1 - i0)
+                keep_first(&p, i0 + k, j);
+        }
+        return p;
+    }
+
+    for (j0 = 0; j0 < c->n; j0 += TILE)
+    {
+        j1 = j0 + TILE < c->n ? j0 + TILE : c->n;
+        for (i = i0; i < i1 && i < p.i; ++i)
+        {
+            for (j = j0; j < j1; ++j)
+            {
+                if (entry_differs(c, x_at(c, i, j), y_at(c, i, j)))
+                {
+                    keep_first(&p, i, j);
+                    break;
+                }
+            }
+        }
+    }
+
+    return p;
+}
+
+/*
+ * Thread comparing bands, taken in increasing order, until all bands are
+ * compared or a band before the next one has a mismatch.
+ */
+static void *compare_bands(void *arg)
+{
+    Worker *w = (Worker*) arg;
+    Shared *sh = w->sh;
+    const Strided *c = sh->c;
+    Position p;
+    size_t band;
+    size_t found;
+
+    for (;;)
+    {
+        band = __atomic_fetch_add(&sh->next, 1, __ATOMIC_RELAXED);
+        if (band >= sh->bands
+                || band > __atomic_load_n(&sh->found, __ATOMIC_RELAXED))
+            break;
+
+        p = compare_band(c, band * TILE,
+                band * TILE + TILE < c->m ? band * TILE + TILE : c->m);
+        if (p.i == c->m)
+            continue;
+
+        keep_first(&w->pos, p.i, p.j);
+        found = __atomic_load_n(&sh->found, __ATOMIC_RELAXED);
+        while (band < found && !__atomic_compare_exchange_n(&sh->found,
+                    &found, band, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            ;
+    }
+
+    return NULL;
+}
+
+/*
+ * Number of threads for the comparison of large matrixes, set with the
+ * CUTEST_THREADS environment variable, or the number of online CPUs.
+ */
+static int get_threads(void)
+{
+    const char *env = getenv("CUTEST_THREADS");
+    long n = env != NULL && atol(env) > 0
+        ? atol(env)
+        : sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (n < 1)
+        return 1;
+    return n > THREAD_MAX ? THREAD_MAX : (int) n;
+}
+
+/*
+ * Find the first mismatch of two strided matrixes in row major order.
+ * Large matrixes are split among threads, each taking the next band to
+ * be compared, so all the bands before the first mismatch are compared
+ * by some thread.
+ */
+static Position compare_strided(const Strided *c)
+{
+    Worker w[THREAD_MAX];
+    Shared sh;
+    Position p = {c->m, 0};
+    int threads = 1;
+    int t;
+
+    sh.c = c;
+    sh.bands = (c->m + TILE - 1) / TILE;
+    sh.next = 0;
+    sh.found = sh.bands;
+
+    if (c->m * c->n >= THREAD_MIN_ENTRIES)
+        threads = get_threads();
+    if ((size_t) threads > sh.bands)
+        threads = (int) sh.bands;
+
+    for (t = 0; t < threads; t++)
+    {
+        w[t].sh = &sh;
+        w[t].pos = p;
+    }
+
+    if (threads == 1)
+    {
+        compare_bands(&w[0]);
+        return w[0].pos;
+    }
+
+    for (t = 0; t < threads; t++)
+    {
+        if (pthread_create(&w[t].tid, NULL, compare_bands, &w[t]))
+        {
+            perror("assert_equals_matrix_strided: pthread_create error.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    for (t = 0; t < threads; t++)
+    {
+        pthread_join(w[t].tid, NULL);
+        keep_first(&p, w[t].pos.i, w[t].pos.j);
+    }
+
+    return p;
+}
+
+/*
+ * Compare two strided matrixes, after the validation of the arguments,
+ * and write the first mismatch in the status message.
+ */
+static void assert_strided(Strided *c, Status *__s)
+{
+    char x_val[32];
+    char y_val[32];
+    Position p;
+
+    c->size = __type_size(c->type);
+    c->x_rs *= c->size;
+    c->x_cs *= c->size;
+    c->y_rs *= c->size;
+    c->y_cs *= c->size;
+
+    p = compare_strided(c);
+
+    __s->failed = p.i < c->m;
+    __s->invalid = 0;
+    if (!__s->failed)
+        return;
+
+    __format_entry(x_val, sizeof (x_val), x_at(c, p.i, p.j), c->type);
+    __format_entry(y_val, sizeof (y_val), y_at(c, p.i, p.j), c->type);
+    snprintf(__s->message, MSG_LEN, "First mismatch at [%zu][%zu]: %s != %s.",
+            p.i, p.j, x_val, y_val);
+}
+
+/*
+ * Check the size of the matrixes, marking the assertion as invalid if it
+ * is not positive.
+ */
+static int check_size(size_t m, size_t n, Status *__s)
+{
+    if ((ptrdiff_t) m >= 1 && (ptrdiff_t) n >= 1)
+        return 1;
+
+    snprintf(__s->message, MSG_LEN,
+            "Invalid matrix size. Dimension must be > 0.");
+    __s->failed = 1;
+    __s->invalid = 1;
+    return 0;
+}
+
+/*!
+ * This function actually implements the type generic equality assertion
+ * on strided matrixes.
+ */
+int __assert_equals_strided(
+        const void *x,
+        const void *y,
+        size_t m,
+        size_t n,
+        const ptrdiff_t *strides,
+        int x_type,
+        int y_type,
+        Status *__s)
+{
+    Strided c = {x, y, m, n, strides[0], strides[1], strides[2], strides[3],
+        x_type, 0, 0.0};
+
+    if (!check_size(m, n, __s))
+        return 0;
+
+    if (x_type != y_type)
+    {
+        snprintf(__s->message, MSG_LEN,
+                "Invalid comparison between entries of different types.");
+        __s->failed = 1;
+        __s->invalid = 1;
+        return 0;
+    }
+
+    assert_strided(&c, __s);
+    return 0;
+}
+
+/*!
+ * This function actually implements the floating point equality assertion
+ * on strided matrixes.
+ */
+int __assert_equals_strided_flo(
+        const double *x,
+        const double *y,
+        size_t m,
+        size_t n,
+        const ptrdiff_t *strides,
+        double tol,
+        Status *__s)
+{
+    Strided c = {(const char*) x, (const char*) y, m, n, 
+        strides[0], strides[1], strides[2], strides[3], TYPE_DOUBLE, 0, tol};
+
+    if (!check_size(m, n, __s))
+        return 0;
+
+    if (!(tol > 0.0))
+    {
+        snprintf(__s->message, MSG_LEN,
+                "Invalid \"tol\" value (%.6e). \"Tol\" must be positive",
+                tol);
+        __s->failed = 1;
+        __s->invalid = 1;
+        return 0;
+    }
+
+    assert_strided(&c, __s);
+    return 0;
+}
@@ -0,0 +1,456 @@
+/*
+ * This file is part of cUTest.
+ *
+ * cUTest is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cUTest is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cUTest. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Martino Pilia, 2015
+ */
+
+/*!
+ * \file options.c
+ *
+ * @author Martino Pilia
+ * @date 2015-01-13
+ */
+
+#include <fnmatch.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cutest.h"
+
+/*
+ * Options set from the command line, overriding the environment. NULL
+ * when not set.
+ */
+static const char *opt_filter = NULL;
+static const char *opt_shard = NULL;
+static const char *opt_shard_by = NULL;
+static const char *opt_max_failures = NULL;
+static int opt_failed_first = 0;
+static int opt_track_alloc = 0;
+static int opt_perf = 0;
+
+/*
+ * Number of test cases considered for sharding so far. Test cases are
+ * assigned to shards in round robin, across all the suites run by the
+ * process, so that shards are balanced also for small suites.
+ */
+static unsigned int shard_next = 0;
+
+/*
+ * Expected duration of the test cases assigned to each shard so far, in
+ * microseconds, when shards are balanced by duration.
+ */
+static long *shard_load = NULL;
+
+/*
+ * Read the value of an option in the form --name=value or --name value,
+ * removing it from the arguments. Return NULL if the argument in position
+ * i is not the option.
+ */
+static const char* take_option(
+        const char *name,
+        int *argc,
+        char **argv,
+        int i)
+{
+    size_t len = strlen(name);
+    const char *value;
+    int n = 1;
+
+    if (strncmp(argv[i], name, len))
+        return NULL;
+
+    if (argv[i][len] == '=')
+        value = argv[i] + len + 1;
+    else if (argv[i][len] == '\0' && i + 1 < *argc)
+    {
+        value = argv[i + 1];
+        n = 2;
+    }
+    else
+        return NULL;
+
+    memmove(&argv[i], &argv[i + n], (*argc - i - n + 1) * sizeof (char*));
+    *argc -= n;
+
+    return value;
+}
+
+/*
+ * Check if the argument in position i is the given flag, removing it from
+ * the arguments.
+ */
+static int take_flag(const char *name, int *argc, char **argv, int i)
+{
+    if (strcmp(argv[i], name))
+        return 0;
+
+    memmove(&argv[i], &argv[i + 1], (*argc - i) * sizeof (char*));
+    (*argc)--;
+
+    return 1;
+}
+
+/*
+ * Parse a shard specification in the form i/N, with 1 <= i <= N.
+ */
+static void parse_shard(const char *spec, int *index, int *count)
+{
+    char end;
+
+    if (sscanf(spec, "%d/%d%c", index, count, &end) != 2
+            || *count < 1 || *index < 1 || *index > *count)
+    {
+        fprintf(stderr, "cutest: invalid shard \"%s\", expected i/N with "
+                "1 <= i <= N.\n", spec);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*!
+ * Parse the command line options of the test program, removing the
+ * recognized ones from the arguments.
+ */
+int cutest_parse_args(int *argc, char **argv)
+{
+    const char *value;
+    int index;
+    int count;
+    int i = 1;
+
+    while (i < *argc)
+    {
+        if ((value = take_option("--filter", argc, argv, i)) != NULL)
+            opt_filter = value;
+        else if (take_flag("--fail-fast", argc, argv, i))
+            opt_max_failures = "1";
+        else if (take_flag("--failed-first", argc, argv, i))
+            opt_failed_first = 1;
+        else if (take_flag("--track-alloc", argc, argv, i))
+            opt_track_alloc = 1;
+        else if (take_flag("--perf", argc, argv, i))
+            opt_perf = 1;
+        else if ((value = take_option("--max-failures", argc, argv, i)))
+            opt_max_failures = value;
+        else if ((value = take_option("--shard-by", argc, argv, i)) != NULL)
+            opt_shard_by = value;
+        else if ((value = take_option("--shard", argc, argv, i)) != NULL)
+        {
+            parse_shard(value, &index, &count);
+            opt_shard = value;
+        }
+        else
+            i++;
+    }
+
+    return 0;
+}
+
+/*
+ * Check if a pattern matches the full name or the plain name of a test.
+ */
+static int match(const char *pattern, const char *full, const char *name)
+{
+    return !fnmatch(pattern, full, 0) || !fnmatch(pattern, name, 0);
+}
+
+/*
+ * Check if a test case matches a comma separated list of glob patterns. 
+ * Patterns starting with '!' exclude the matching test cases. A test case
+ * is selected if it matches some inclusive pattern (or there are only
+ * exclusive patterns) and no exclusive pattern.
+ */
+static int match_filter(
+        const char *filter,
+        const char *full,
+        const char *name)
+{
+    char pattern[2 * NAME_LEN + 2];
+    const char *p = filter;
+    const char *end;
+    size_t len;
+    int included = 1;
+    int selected = 0;
+
+    for (; *p != '\0'; p = *end != '\0' ? end + 1 : end)
+    {
+        end = strchr(p, ',');
+        if (end == NULL)
+            end = p + strlen(p);
+
+        len = (size_t) (end - p);
+        if (len > sizeof (pattern) - 1)
+            len = sizeof (pattern) - 1;
+        memcpy(pattern, p, len);
+        pattern[len] = '\0';
+
+        if (pattern[0] == '!')
+        {
+            if (match(pattern + 1, full, name))
+                return 0;
+        }
+        else if (len > 0)
+        {
+            included = 0;
+            if (match(pattern, full, name))
+                selected = 1;
+        }
+    }
+
+    return selected || included;
+}
+
+/*
+ * Item for the sorting of test cases by expected duration.
+ */
+typedef struct timed
+{
+    long est; /* expected duration */
+    int i;    /* position in the suite */
+} Timed;
+
+/*
+ * Compare test cases by decreasing expected duration, and then by 
+ * position, for qsort().
+ */
+static int cmp_timed(const void *a, const void *b)
+{
+    const Timed *x = (const Timed*) a;
+    const Timed *y = (const Timed*) b;
+
+    if (x->est != y->est)
+        return (x->est < y->est) - (x->est > y->est);
+    return (x->i > y->i) - (x->i < y->i);
+}
+
+/*!
+ * Sort the positions of test cases by decreasing expected duration, for
+ * a longest-processing-time-first schedule.
+ */
+int __sort_by_duration(const long *est, int n, int *order)
+{
+    Timed *t = (Timed*) malloc(n * sizeof (Timed));
+    int i;
+
+    if (t == NULL)
+    {
+        perror("suite_run: malloc error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        t[i].est = est[i];
+        t[i].i = i;
+    }
+    qsort(t, n, sizeof (Timed), cmp_timed);
+    for (i = 0; i < n; i++)
+        order[i] = t[i].i;
+
+    free(t);
+    return 0;
+}
+
+/*
+ * Keep the test cases of the given shard, assigning them in round robin.
+ */
+static int shard_round_robin(Test_case **sel, int n, int index, int count)
+{
+    int k = 0;
+    int i;
+
+    for (i = 0; i < n; i++)
+        if (shard_next++ % count == (unsigned int) index - 1)
+            sel[k++] = sel[i];
+
+    return k;
+}
+
+/*
+ * Keep the test cases of the given shard, assigning each test case, from
+ * the longest to the shortest, to the shard with the least expected 
+ * duration. The order of the test cases is preserved.
+ */
+static int shard_by_time(
+        const char *suite,
+        Test_case **sel,
+        int n,
+        int index,
+        int count)
+{
+    int *order = (int*) malloc(n * sizeof (int));
+    char *keep = (char*) calloc(n, 1);
+    long *est = (long*) malloc(n * sizeof (long));
+    int best;
+    int j;
+    int k = 0;
+    int i;
+
+    if (shard_load == NULL)
+        shard_load = (long*) calloc(count, sizeof (long));
+    if (order == NULL || keep == NULL || est == NULL || shard_load == NULL)
+    {
+        perror("suite_run: malloc error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    __cache_estimate(suite, sel, n, est);
+    __sort_by_duration(est, n, order);
+    for (i = 0; i < n; i++)
+    {
+        for (best = 0, j = 1; j < count; j++)
+            if (shard_load[j] < shard_load[best])
+                best = j;
+        shard_load[best] += est[order[i]];
+        keep[order[i]] = best == index - 1;
+    }
+
+    for (i = 0; i < n; i++)
+        if (keep[i])
+            sel[k++] = sel[i];
+
+    free(est);
+    free(keep);
+    free(order);
+    return k;
+}
+
+/*!
+ * Select the test cases of a suite to be executed, according to the
+ * filter and the shard set with cutest_parse_args() or with the
+ * <tt>CUTEST_FILTER</tt>, <tt>CUTEST_SHARD</tt> and <tt>CUTEST_SHARD_BY</tt>
+ * environment variables.
+ * A test case matches the filter when its name, or its name prefixed by
+ * the suite name and a slash, matches.
+ */
+int __suite_select(Suite *s, Test_case **sel)
+{
+    const char *filter = opt_filter != NULL ? opt_filter 
+        : getenv("CUTEST_FILTER");
+    const char *shard = opt_shard != NULL ? opt_shard 
+        : getenv("CUTEST_SHARD");
+    const char *shard_by = opt_shard_by != NULL ? opt_shard_by
+        : getenv("CUTEST_SHARD_BY");
+    char full[2 * NAME_LEN + 2];
+    Test_case *tc;
+    int index = 1;
+    int count = 1;
+    int n = 0;
+    unsigned int i;
+
+    if (filter != NULL && *filter == '\0')
+        filter = NULL;
+    if (shard != NULL && *shard != '\0')
+        parse_shard(shard, &index, &count);
+
+    for (i = 0; i < s->tests_len; i++)
+    {
+        tc = &s->tests[i];
+
+        if (filter != NULL)
+        {
+            snprintf(full, sizeof (full), "%s/%s", s->name, tc->name);
+            if (!match_filter(filter, full, tc->name))
+                continue;
+        }
+
+        sel[n++] = tc;
+    }
+
+    if (count < 2 || n == 0)
+        return n;
+
+    if (shard_by != NULL && !strcmp(shard_by, "time"))
+        return shard_by_time(s->name, sel, n, index, count);
+
+    if (shard_by != NULL && *shard_by != '\0' && strcmp(shard_by, "index"))
+    {
+        fprintf(stderr, "cutest: invalid shard criterion \"%s\", expected "
+                "index or time.\n", shard_by);
+        exit(EXIT_FAILURE);
+    }
+
+    return shard_round_robin(sel, n, index, count);
+}
+
+/*!
+ * Number of failed test cases, counted across all the suite runs, after
+ * which the remaining test cases are cancelled, or 0 for no limit. It is
+ * set with the --fail-fast and --max-failures options, or with the 
+ * <tt>CUTEST_MAX_FAILURES</tt> environment variable.
+ */
+int __max_failures(void)
+{
+    const char *value = opt_max_failures != NULL ? opt_max_failures
+        : getenv("CUTEST_MAX_FAILURES");
+
+    if (value == NULL || atoi(value) < 0)
+        return 0;
+
+    return atoi(value);
+}
+
+/*!
+ * Check if the test cases failed in the previous run must be executed
+ * first, as set with the --failed-first option, or with the 
+ * <tt>CUTEST_FAILED_FIRST</tt> environment variable.
+ */
+int __failed_first(void)
+{
+    const char *env = getenv("CUTEST_FAILED_FIRST");
+
+    return opt_failed_first || (env != NULL && *env != '\0' 
+            && strcmp(env, "0"));
+}
+
+/*!
+ * Check if the results of the test cases must be recorded in the cache,
+ * because the <tt>CUTEST_CACHE</tt> environment variable is set, or 
+ * because the test cases are ordered or sharded according to it.
+ */
+int __cache_wanted(void)
+{
+    const char *shard_by = opt_shard_by != NULL ? opt_shard_by
+        : getenv("CUTEST_SHARD_BY");
+
+    return getenv("CUTEST_CACHE") != NULL || __failed_first()
+        || (shard_by != NULL && !strcmp(shard_by, "time"));
+}
+
+/*!
+ * Check if the heap allocations of the test cases must be counted, as set
+ * with the --track-alloc option, or with the <tt>CUTEST_TRACK_ALLOC</tt>
+ * environment variable.
+ */
+int __track_alloc(void)
+{
+    const char *env = getenv("CUTEST_TRACK_ALLOC");
+
+    return opt_track_alloc || (env != NULL && *env != '\0' 
+            && strcmp(env, "0"));
+}
+
+/*!
+ * Check if the hardware counters of the test cases and benchmarks must be
+ * read, as set with the --perf option, or with the <tt>CUTEST_PERF</tt>
+ * environment variable.
+ */
+int __perf_enabled(void)
+{
+    const char *env = getenv("CUTEST_PERF");
+
+    return opt_perf || (env != NULL && *env != '\0' && strcmp(env, "0"));
+}
@@ -0,0 +1,228 @@
+/*
+ * This file is part of cUTest.
+ *
+ * cUTest is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cUTest is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cUTest. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Martino Pilia, 2015
+ */
+
+/*!
+ * \file perf.c
+ *
+ * @author Martino Pilia
+ * @date 2015-01-13
+ */
+
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "cutest.h"
+
+/*
+ * Hardware events counted, in the order of the PERF_* indexes.
+ */
+static const uint64_t events[PERF_COUNTERS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES
+};
+
+/*
+ * Counter group of the process. The events which cannot be opened (e.g.
+ * inside virtual machines, or when perf_event_paranoid forbids it) are
+ * left out of the group, and their bits are not set in the mask. The
+ * group is opened again by a forked child, since counters only follow
+ * the thread which opened them.
+ */
+static int fds[PERF_COUNTERS] = {-1, -1, -1, -1};
+static int leader = -1;
+static int mask = 0;
+static pid_t owner = 0;
+static int running = 0;
+
+/*
+ * Open a counter for the calling thread, user space only, as a member of
+ * the given group, or as the disabled leader of a new group if group is
+ * -1. Return the file descriptor, or -1 on failure.
+ */
+static int open_counter(uint64_t event, int group)
+{
+    struct perf_event_attr pe;
+
+    memset(&pe, 0, sizeof (pe));
+    pe.type = PERF_TYPE_HARDWARE;
+    pe.size = sizeof (pe);
+    pe.config = event;
+    pe.disabled = group == -1;
+    pe.exclude_kernel = 1;
+    pe.exclude_hv = 1;
+    pe.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED
+        | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return (int) syscall(SYS_perf_event_open, &pe, 0, -1, group,
+            PERF_FLAG_FD_CLOEXEC);
+}
+
+/*
+ * Open the counter group for the calling process, closing the one
+ * inherited from the parent, if any.
+ */
+static void open_group(void)
+{
+    int i;
+
+    for (i = 0; i < PERF_COUNTERS; i++)
+    {
+        if (fds[i] >= 0)
+            close(fds[i]);
+        fds[i] = -1;
+    }
+    leader = -1;
+    mask = 0;
+    running = 0;
+    owner = getpid();
+
+    for (i = 0; i < PERF_COUNTERS; i++)
+    {
+        fds[i] = open_counter(events[i], leader);
+        if (fds[i] < 0)
+            continue;
+
+        if (leader < 0)
+            leader = fds[i];
+        mask |= 1 << i;
+    }
+}
+
+/*!
+ * Reset and start the hardware counters of the calling thread. Nothing
+ * is counted if the counters are not available.
+ */
+void __perf_start(void)
+{
+    if (owner != getpid())
+        open_group();
+
+    if (leader < 0)
+        return;
+
+    ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    running = 1;
+}
+
+/*!
+ * Read the hardware counters since the last start, without stopping them.
+ * The counts are scaled when the group was multiplexed with other events,
+ * and the mask is empty if the counters are not running.
+ */
+void __perf_read(Perf_counters *pc)
+{
+    uint64_t buf[3 + PERF_COUNTERS];
+    double scale;
+    int n = 0;
+    int i;
+
+    memset(pc, 0, sizeof (Perf_counters));
+    if (!running || owner != getpid())
+        return;
+
+    /* number of values, time enabled, time running, values */
+    if (read(leader, buf, sizeof (buf)) < (ssize_t) (3 * sizeof (uint64_t))
+            || buf[2] == 0)
+        return;
+
+    scale = (double) buf[1] / buf[2];
+    for (i = 0; i < PERF_COUNTERS && n < (int) buf[0]; i++)
+    {
+        if (!(mask & (1 << i)))
+            continue;
+        pc->value[i] = (long) (buf[3 + n++] * scale);
+    }
+    pc->mask = mask;
+}
+
+/*!
+ * Stop the hardware counters, and read them.
+ */
+void __perf_stop(Perf_counters *pc)
+{
+    if (running && owner == getpid())
+        ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    __perf_read(pc);
+    running = 0;
+}
+
+/*!
+ * Print a notice on the standard error, once per process, when some 
+ * hardware counters cannot be opened, so that their absence from the
+ * reports and the unchecked instruction assertions are not silent.
+ */
+void __perf_notice(void)
+{
+    static int noticed = 0;
+
+    if (noticed)
+        return;
+    noticed = 1;
+
+    if (owner != getpid())
+        open_group();
+
+    if (mask == (1 << PERF_COUNTERS) - 1)
+        return;
+
+    fprintf(stderr, "cutest: %s hardware counters are not available%s.\n",
+            mask == 0 ? "the" : "some",
+            mask & (1 << PERF_INSTRUCTIONS) ? ""
+            : ", assert_instructions_below() is not checked");
+}
+
+/*!
+ * This function actually implements the check of the instructions
+ * executed by the test case. The assertion is invalid when the counters
+ * are not enabled, and succeeds, after the notice printed by the runner,
+ * when the instructions counter is not available.
+ */
+int __assert_instructions_below(long n, Status *__s)
+{
+    Perf_counters pc;
+
+    if (!__perf_enabled())
+    {
+        snprintf(__s->message, MSG_LEN,
+                "Hardware counters are not enabled (see --perf).");
+        __s->failed = 1;
+        __s->invalid = 1;
+        return 0;
+    }
+
+    __perf_read(&pc);
+
+    __s->failed = (pc.mask & (1 << PERF_INSTRUCTIONS))
+        && pc.value[PERF_INSTRUCTIONS] >= n;
+    __s->invalid = 0;
+    if (__s->failed)
+        snprintf(__s->message, MSG_LEN,
+                "%ld instructions executed, bound %ld.",
+                pc.value[PERF_INSTRUCTIONS], n);
+
+    return 0;
+}
@@ -0,0 +1,1428 @@
+/*
+ * This file is part of cUTest.
+ *
+ * cUTest is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cUTest is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cUTest. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Martino Pilia, 2015
+ */
+
+/*!
+ * \file reporter.c
+ *
+ * @author Martino Pilia
+ * @date 2015-01-13
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "cutest.h"
+
+/*
+ * Size of the output buffer of the file reporters.
+ */
+#define OUT_LEN 65536
+
+/*
+ * Maximum time between two writes of a file reporter, in milliseconds,
+ * so that results are streamed also when the buffer is not full.
+ */
+#define OUT_INTERVAL 1000
+
+/*
+ * Maximum number of reporters active at the same time.
+ */
+#define REPORTER_MAX 8
+
+/*
+ * A type for the buffered output of a file reporter.
+ */
+typedef struct out
+{
+    int fd;            /* destination file descriptor */
+    size_t len;        /* number of buffered characters */
+    long flushed;      /* time of the last write, in milliseconds */
+    int hold;          /* nonzero while the output is held back */
+    char *held;        /* characters held back */
+    size_t held_len;   /* number of characters held back */
+    size_t held_cap;   /* capacity of the held characters */
+    char buf[OUT_LEN]; /* buffered characters */
+} Out;
+
+/*
+ * A type for the state of a built-in file reporter.
+ */
+typedef struct file_reporter
+{
+    Reporter rep;         /* callbacks */
+    Out out;              /* buffered output */
+    int count;            /* number of test cases reported so far */
+    int suites;           /* number of suites reported so far */
+    int open;             /* nonzero while the element of a suite is held */
+    char suite[NAME_LEN]; /* name of the suite held */
+    Summary sum;          /* counts of the suite held */
+} File_reporter;
+
+/*
+ * Reporters receiving the events of the suite runs.
+ */
+static Reporter *reporters[REPORTER_MAX];
+static int reporters_num = 0;
+static int reporters_init = 0;
+
+/*
+ * Process which registered the reporters. Children created by the runner
+ * inherit the reporters, but must never write them.
+ */
+static pid_t reporters_pid;
+
+/*
+ * Current time from a monotonic clock, in milliseconds.
+ */
+static long now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * Write the buffered output to its file descriptor.
+ */
+static void out_flush(Out *o)
+{
+    size_t done = 0;
+    ssize_t n;
+
+    if (o->fd == STDOUT_FILENO) /* keep the order with the console */
+        fflush(stdout);
+
+    while (done < o->len)
+    {
+        n = write(o->fd, o->buf + done, o->len - done);
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n == -1)
+        {
+            perror("reporter: write error.\n");
+            exit(EXIT_FAILURE);
+        }
+        done += n;
+    }
+
+    o->len = 0;
+    o->flushed = now_ms();
+}
+
+/*
+ * Append a character to the buffered output, or to the held characters
+ * while the output is held back.
+ */
+static void out_putc(Out *o, char c)
+{
+    if (o->hold)
+    {
+        if (o->held_len == o->held_cap)
+        {
+            o->held_cap = o->held_cap ? 2 * o->held_cap : OUT_LEN;
+            o->held = (char*) realloc(o->held, o->held_cap);
+            if (o->held == NULL)
+            {
+                perror("reporter: malloc error.\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        o->held[o->held_len++] = c;
+        return;
+    }
+
+    if (o->len == OUT_LEN)
+        out_flush(o);
+    o->buf[o->len++] = c;
+}
+
+/*
+ * Stop holding back the output, and append the held characters, so that
+ * text written meanwhile precedes them.
+ */
+static void out_release(Out *o)
+{
+    size_t i;
+
+    o->hold = 0;
+    for (i = 0; i < o->held_len; i++)
+        out_putc(o, o->held[i]);
+    o->held_len = 0;
+}
+
+/*
+ * Append a string to the buffered output.
+ */
+static void out_puts(Out *o, const char *str)
+{
+    while (*str != '\0')
+        out_putc(o, *str++);
+}
+
+/*
+ * Append formatted text to the buffered output. The text must be short,
+ * strings of arbitrary length are written with out_puts().
+ */
+static void out_printf(Out *o, const char *fmt, ...)
+{
+    char tmp[256];
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(tmp, sizeof (tmp), fmt, ap);
+    va_end(ap);
+
+    out_puts(o, tmp);
+}
+
+/*
+ * Append a string to the buffered output, escaping the XML special 
+ * characters.
+ */
+static void out_xml(Out *o, const char *str)
+{
+    for (; *str != '\0'; str++)
+    {
+        switch (*str)
+        {
+            case '&': out_puts(o, "&amp;"); break;
+            case '<': out_puts(o, "&lt;"); break;
+            case '>': out_puts(o, "&gt;"); break;
+            case '"': out_puts(o, "&quot;"); break;
+            case '\'': out_puts(o, "&apos;"); break;
+            default:
+                if ((unsigned char) *str < 0x20 && *str != '\n'
+                        && *str != '\t')
+                    out_putc(o, '?'); /* not allowed in XML 1.0 */
+                else
+                    out_putc(o, *str);
+        }
+    }
+}
+
+/*
+ * Append a string to the buffered output as a quoted JSON string.
+ */
+static void out_json(Out *o, const char *str)
+{
+    out_putc(o, '"');
+    for (; *str != '\0'; str++)
+    {
+        switch (*str)
+        {
+            case '"': out_puts(o, "\\\""); break;
+            case '\\': out_puts(o, "\\\\"); break;
+            case '\n': out_puts(o, "\\n"); break;
+            case '\t': out_puts(o, "\\t"); break;
+            default:
+                if ((unsigned char) *str < 0x20)
+                    out_printf(o, "\\u%04x", *str);
+                else
+                    out_putc(o, *str);
+        }
+    }
+    out_putc(o, '"');
+}
+
+/*
+ * Write the buffered output if it has not been written for a while.
+ */
+static void out_stream(Out *o)
+{
+    if (now_ms() - o->flushed >= OUT_INTERVAL)
+        out_flush(o);
+}
+
+/*!
+ * Classify the outcome of a completed test case.
+ */
+int __result_outcome(const Result *res)
+{
+    if (res->error || res->invalid)
+        return OUTCOME_ERROR;
+    if (res->failed)
+        return OUTCOME_FAILURE;
+    return OUTCOME_SUCCESS;
+}
+
+/*
+ * Describe the error of a test case, or of its AFTER_TEST procedure when
+ * cleanup is nonzero. Return zero if there is no error to be described.
+ */
+static int describe_error(
+        const Result *res,
+        int cleanup,
+        char *buf,
+        size_t len)
+{
+    const char *what = res->error == PHASE_BEFORE ? "BEFORE_TEST procedure"
+        : res->error == PHASE_BEFORE_ALL ? "BEFORE_ALL procedure" : "test";
+
+    if (cleanup)
+    {
+        if (res->cleanup_timeout)
+            snprintf(buf, len, "AFTER_TEST procedure timed out after %ld ms",
+                    res->cleanup_timeout);
+        else if (res->cleanup_sig)
+            snprintf(buf, len, "AFTER_TEST procedure terminated by signal %d",
+                    res->cleanup_sig);
+        else if (res->cleanup_status)
+            snprintf(buf, len, "AFTER_TEST procedure failed with status %d",
+                    res->cleanup_status);
+        else
+            return 0;
+        return 1;
+    }
+
+    if (res->error == 0)
+        return 0;
+
+    if (res->timeout)
+        snprintf(buf, len, "%s timed out after %ld ms", what, res->timeout);
+    else if (res->term_sig)
+        snprintf(buf, len, "%s terminated by signal %d", what, res->term_sig);
+    else
+        snprintf(buf, len, "%s failed with status %d", what,
+                res->exit_status);
+    return 1;
+}
+
+/*
+ * Describe the error of a benchmark. Return zero if it completed.
+ */
+static int describe_bench_error(const Bench_stats *bs, char *buf, size_t len)
+{
+    if (!bs->error)
+        return 0;
+
+    if (bs->term_sig)
+        snprintf(buf, len, "benchmark terminated by signal %d", 
+                bs->term_sig);
+    else
+        snprintf(buf, len, "benchmark failed with status %d", 
+                bs->exit_status);
+    return 1;
+}
+
+/*
+ * Console reporter: print the header of a suite run.
+ */
+static void console_start(Reporter *rep, const Suite *s, int tests)
+{
+    (void) rep;
+
+    printf("** Starting suite \"%s\" **\n", s->name);
+
+    if (s->tests_len < 1 && s->benchmarks.size < 1) /* empty suite */
+        printf("  Suite \"%s\" does not contain any test case.\n", s->name);
+    else if (tests < 1 && s->tests_len > 0)
+        printf("  No test case of suite \"%s\" selected.\n", s->name);
+}
+
+/*
+ * Console reporter: print the outcome of a completed test case.
+ */
+static void console_result(
+        Reporter *rep,
+        const Suite *s,
+        const Test_case *tc,
+        const Result *res)
+{
+    (void) rep;
+
+    if (res->error == PHASE_BEFORE || res->error == PHASE_BEFORE_ALL)
+    {
+        const char *what = res->error == PHASE_BEFORE 
+            ? "BEFORE_TEST" : "BEFORE_ALL";
+
+        if (res->timeout) /* child process killed after timeout */
+            printf( "Suite \"%s\", test case \"%s\", error:\n"
+                    "  %s procedure timed out after %ld ms."
+                    "  Test case execution aborted.\n\n",
+                    s->name,
+                    tc->name,
+                    what,
+                    res->timeout);
+        else if (res->term_sig) /* child process signaled */
+            printf( "Suite \"%s\", test case \"%s\", error:\n"
+                    "  %s procedure terminated by signal %d. "
+                    "  Test case execution aborted.\n\n",
+                    s->name,
+                    tc->name,
+                    what,
+                    res->term_sig);
+        else /* child process did not quit normally */
+            printf( "Suite \"%s\", test case \"%s\", error:\n"
+                    "  %s procedure failed with status %d."
+                    "  Test case execution aborted.\n\n",
+                    s->name,
+                    tc->name,
+                    what,
+                    res->exit_status);
+        return;
+    }
+
+    if (res->error == PHASE_TEST)
+    {
+        if (res->timeout) /* child process killed after timeout */
+            printf( "Suite \"%s\", test case \"%s\", error:\n"
+                    "  test timed out after %ld ms.\n\n",
+                    s->name,
+                    tc->name,
+                    res->timeout);
+        else if (res->term_sig) /* child process signaled */
+            printf( "Suite \"%s\", test case \"%s\", error:\n"
+                    "  test terminated by signal %d.\n\n",
+                    s->name,
+                    tc->name,
+                    res->term_sig);
+        else /* child process did not terminate normally */
+            printf( "Suite \"%s\", test case \"%s\", error:\n"
+                    "  test failed with status %d.\n\n",
+                    s->name,
+                    tc->name,
+                    res->exit_status);
+    }
+
+    if (res->cleanup_timeout) /* AFTER_TEST process killed after timeout */
+        printf( "Suite \"%s\", test case \"%s\", error on cleanup:\n"
+                "  AFTER_TEST procedure timed out after %ld ms.\n\n",
+                s->name,
+                tc->name,
+                res->cleanup_timeout);
+    else if (res->cleanup_sig) /* AFTER_TEST process signaled */
+        printf( "Suite \"%s\", test case \"%s\", error on cleanup:\n"
+                "  AFTER_TEST procedure terminated by signal %d.\n\n",
+                s->name,
+                tc->name,
+                res->cleanup_sig);
+    else if (res->cleanup_status) /* AFTER_TEST process failed */
+        printf( "Suite \"%s\", test case \"%s\", error on cleanup:\n"
+                "  AFTER_TEST procedure failed with status %d.\n\n",
+                s->name,
+                tc->name,
+                res->cleanup_status);
+
+    if (res->alloc.blocks > 0) /* blocks not freed after AFTER_TEST */
+        printf( "Suite \"%s\", test case \"%s\", memory leak:\n"
+                "  %ld of %ld blocks not freed (%ld bytes).\n\n",
+                s->name,
+                tc->name,
+                res->alloc.blocks,
+                res->alloc.allocs,
+                res->alloc.leaked);
+
+    if (res->error) /* no status from the test case */
+        return;
+
+    if (res->invalid) /* write message if test was invalid */
+    {
+        printf( "Suite \"%s\", test case \"%s\", invalid assertion:\n"
+                "  %s:%d: %s\n"
+                "  %s\n\n",
+                s->name,
+                tc->name,
+                res->file,
+                res->line,
+                res->assertion,
+                res->message != NULL ? res->message : "");
+    }
+    else if (res->failed) /* write message if test failed */
+    {
+        printf( "Suite \"%s\", test case \"%s\", assertion failure:\n"
+                "  %s:%d: %s\n",
+                s->name,
+                tc->name,
+                res->file,
+                res->line,
+                res->assertion);
+        if (res->message != NULL)
+            printf("  %s\n", res->message);
+        printf("\n");
+    }
+}
+
+/*
+ * Number of slowest test cases to be listed in the suite summary, set 
+ * with the CUTEST_SLOWEST environment variable.
+ */
+static int get_slowest(void)
+{
+    const char *env = getenv("CUTEST_SLOWEST");
+
+    if (env != NULL && *env != '\0')
+        return atoi(env);
+
+    return 5;
+}
+
+/*
+ * Compare two results by decreasing wall time, for qsort().
+ */
+static int cmp_wall(const void *a, const void *b)
+{
+    const Result *x = *(const Result**) a;
+    const Result *y = *(const Result**) b;
+
+    return (x->m.wall_us < y->m.wall_us) - (x->m.wall_us > y->m.wall_us);
+}
+
+/*
+ * Names of the hardware counters, in the order of the PERF_* indexes.
+ */
+static const char *perf_names[PERF_COUNTERS] = {
+    "cycles", "instructions", "cache_misses", "branch_misses"
+};
+
+/*
+ * Print the hardware counters of a test case, when available.
+ */
+static void print_counters(const Perf_counters *pc)
+{
+    const char *sep = "             ";
+    int i;
+
+    if (pc->mask == 0)
+        return;
+
+    for (i = 0; i < PERF_COUNTERS; i++)
+    {
+        if (!(pc->mask & (1 << i)))
+            continue;
+        printf("%s%s %ld", sep, perf_names[i], pc->value[i]);
+        sep = ", ";
+    }
+    printf("\n");
+}
+
+/*
+ * Print the slowest test cases of a suite run, with their resource usage.
+ */
+static void print_slowest(const Summary *sum)
+{
+    const Result **sorted;
+    const Result *res;
+    int n = get_slowest();
+    int tot = 0;
+    int i;
+
+    if (n <= 0)
+        return;
+    if (n > sum->tests)
+        n = sum->tests;
+
+    sorted = (const Result**) malloc(sum->tests * sizeof (Result*));
+    if (sorted == NULL)
+    {
+        perror("suite_run: malloc error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    /* cancelled test cases are not executed */
+    for (i = 0; tot < sum->tests; i++)
+        if (!sum->results[i].cancelled)
+            sorted[tot++] = &sum->results[i];
+    qsort(sorted, sum->tests, sizeof (Result*), cmp_wall);
+
+    printf(" Slowest test cases:\n");
+    for (i = 0; i < n; i++)
+    {
+        res = sorted[i];
+        printf( "  %8.3f s  \"%s\" (user %.3f s, sys %.3f s, max RSS %ld kB,"
+                " faults %ld/%ld, ctx switches %ld/%ld)\n",
+                res->m.wall_us / 1e6,
+                sum->tcs[res - sum->results]->name,
+                res->m.user_us / 1e6,
+                res->m.sys_us / 1e6,
+                res->m.max_rss,
+                res->m.minflt,
+                res->m.majflt,
+                res->m.nvcsw,
+                res->m.nivcsw);
+        print_counters(&res->perf);
+    }
+
+    free(sorted);
+}
+
+/*
+ * Console reporter: print the summary of a suite run.
+ */
+static void console_end(Reporter *rep, const Suite *s, const Summary *sum)
+{
+    int tot = sum->tests;
+    int char_num;
+
+    (void) rep;
+
+    if (sum->after_all_sig) /* fixture process signaled */
+        printf( "Suite \"%s\", error:\n"
+                "  AFTER_ALL procedure terminated by signal %d.\n\n",
+                s->name,
+                sum->after_all_sig);
+    else if (sum->after_all_status) /* fixture process failed */
+        printf( "Suite \"%s\", error:\n"
+                "  AFTER_ALL procedure failed with status %d.\n\n",
+                s->name,
+                sum->after_all_status);
+
+    if (tot < 1)
+    {
+        if (sum->cancelled > 0)
+            printf("Suite \"%s\" cancelled: %d test cases not run "
+                    "(fail fast).\n\n",
+                    s->name,
+                    sum->cancelled);
+        return;
+    }
+
+    char_num = (sum->successes == tot || sum->failures == tot 
+            || sum->errors == tot ? 6 : 5);
+    printf("\nSuite \"%s\" execution complete:\n"
+            " %d success%2s (%*.2f%%)\n"
+            " %d failure%s  (%*.2f%%)\n"
+            " %d error%s    (%*.2f%%)\n",
+            s->name,
+            sum->successes,
+            sum->successes == 1 ? "  " : "es",
+            char_num,
+            (float) sum->successes / tot * 100,
+            sum->failures,
+            sum->failures == 1 ? " " : "s",
+            char_num,
+            (float) sum->failures / tot * 100,
+            sum->errors,
+            sum->errors == 1 ? " " : "s",
+            char_num,
+            (float) sum->errors / tot * 100);
+    if (sum->skipped > 0)
+        printf(" %d skipped (not selected)\n", sum->skipped);
+    if (sum->cancelled > 0)
+        printf(" %d cancelled (fail fast)\n", sum->cancelled);
+
+    print_slowest(sum);
+
+    if (s->benchmarks.size > 0)
+        printf("\n");
+}
+
+/*
+ * Console reporter: print the median and the minimum over the samples of
+ * the hardware counters of a benchmark per iteration. Counters not 
+ * available are not printed.
+ */
+static void print_bench_counters(const Bench_stats *bs)
+{
+    static const char *names[PERF_COUNTERS] = {
+        "cycles", "instructions", "cache misses", "branch misses"
+    };
+    const char *sep = "  ";
+    int i;
+
+    if (bs->perf_mask == 0)
+        return;
+
+    for (i = 0; i < PERF_COUNTERS; i++)
+    {
+        if (!(bs->perf_mask & (1 << i)))
+            continue;
+        printf("%s%.2f %s/op (min %.2f)", sep, bs->perf_median[i], names[i],
+                bs->perf_min[i]);
+        sep = ", ";
+    }
+    printf("\n");
+}
+
+/*
+ * Console reporter: print the statistics of a benchmark.
+ */
+static void console_bench(
+        Reporter *rep,
+        const Suite *s,
+        const Benchmark *bm,
+        const Bench_stats *bs)
+{
+    char msg[MSG_LEN];
+
+    (void) rep;
+
+    if (describe_bench_error(bs, msg, sizeof (msg)))
+    {
+        printf( "Suite \"%s\", benchmark \"%s\", error:\n  %s.\n\n",
+                s->name,
+                bm->name,
+                msg);
+        return;
+    }
+
+    printf( "Suite \"%s\", benchmark \"%s\":\n"
+            "  %d samples of %zu iterations\n"
+            "  mean %.3f ns/op, median %.3f ns/op, stddev %.3f ns/op,"
+            " min %.3f ns/op\n",
+            s->name,
+            bm->name,
+            bs->samples,
+            bs->iterations,
+            bs->mean,
+            bs->median,
+            bs->stddev,
+            bs->min);
+    print_bench_counters(bs);
+    printf("\n");
+}
+
+/*
+ * Console reporter, writing human readable messages to the standard
+ * output.
+ */
+static Reporter console_reporter = {
+    console_start,
+    console_result,
+    console_end,
+    NULL,
+    NULL,
+    console_bench
+};
+
+/*
+ * Allocate the state of a built-in file reporter.
+ */
+static File_reporter* file_reporter_new(int fd)
+{
+    File_reporter *fr = (File_reporter*) calloc(1, sizeof (File_reporter));
+
+    if (fr == NULL)
+    {
+        perror("reporter: malloc error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    fr->rep.data = fr;
+    fr->out.fd = fd;
+    fr->out.flushed = now_ms();
+
+    return fr;
+}
+
+/*
+ * JUnit reporter: write the element of the suite held, opening it with
+ * the counts of its test cases.
+ */
+static void junit_write_suite(File_reporter *fr)
+{
+    Out *o = &fr->out;
+    const Summary *sum = &fr->sum;
+
+    if (!fr->open)
+        return;
+    fr->open = 0;
+
+    o->hold = 0;
+    out_puts(o, "  <testsuite name=\"");
+    out_xml(o, fr->suite);
+    out_printf(o, "\" tests=\"%d\" failures=\"%d\" errors=\"%d\""
+            " skipped=\"%d\" time=\"%.6f\">\n",
+            sum->tests + sum->cancelled,
+            sum->failures,
+            sum->errors,
+            sum->cancelled,
+            sum->wall_us / 1e6);
+    out_release(o);
+    out_puts(o, "  </testsuite>\n");
+    out_flush(o);
+}
+
+/*
+ * JUnit reporter: start the element of a suite. Its test cases are held
+ * back until the end of the suite, since the attributes of the element
+ * count them.
+ */
+static void junit_start(Reporter *rep, const Suite *s, int tests)
+{
+    File_reporter *fr = (File_reporter*) rep->data;
+
+    (void) tests;
+
+    junit_write_suite(fr);
+    if (fr->suites++ == 0)
+        out_puts(&fr->out, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                "<testsuites>\n");
+
+    snprintf(fr->suite, NAME_LEN, "%s", s->name);
+    memset(&fr->sum, 0, sizeof (Summary));
+    fr->open = 1;
+    fr->out.hold = 1;
+}
+
+/*
+ * JUnit reporter: write the element of a test case.
+ */
+static void junit_result(
+        Reporter *rep,
+        const Suite *s,
+        const Test_case *tc,
+        const Result *res)
+{
+    File_reporter *fr = (File_reporter*) rep->data;
+    Out *o = &fr->out;
+    char msg[MSG_LEN];
+
+    out_puts(o, "    <testcase classname=\"");
+    out_xml(o, s->name);
+    out_puts(o, "\" name=\"");
+    out_xml(o, tc->name);
+    out_printf(o, "\" time=\"%.6f\"", res->m.wall_us / 1e6);
+
+    if (__result_outcome(res) == OUTCOME_SUCCESS 
+            && !describe_error(res, 1, msg, sizeof (msg)))
+    {
+        out_puts(o, "/>\n");
+        out_stream(o);
+        return;
+    }
+    out_puts(o, ">\n");
+
+    if (describe_error(res, 0, msg, sizeof (msg)))
+    {
+        out_puts(o, "      <error message=\"");
+        out_xml(o, msg);
+        out_puts(o, "\"/>\n");
+    }
+    else if (res->failed || res->invalid)
+    {
+        out_puts(o, res->invalid ? "      <error message=\"" 
+                : "      <failure message=\"");
+        out_xml(o, res->message != NULL ? res->message : res->assertion);
+        out_puts(o, "\">");
+        out_xml(o, res->file);
+        out_printf(o, ":%d: ", res->line);
+        out_xml(o, res->assertion);
+        out_puts(o, res->invalid ? "</error>\n" : "</failure>\n");
+    }
+
+    if (describe_error(res, 1, msg, sizeof (msg)))
+    {
+        out_puts(o, "      <system-err>");
+        out_xml(o, msg);
+        out_puts(o, "</system-err>\n");
+    }
+
+    out_puts(o, "    </testcase>\n");
+    out_stream(o);
+}
+
+/*
+ * JUnit reporter: record the counts of a suite, and write the test cases
+ * cancelled by fail fast as skipped. The element is written at the start
+ * of the next suite, or at the end of the document.
+ */
+static void junit_end(Reporter *rep, const Suite *s, const Summary *sum)
+{
+    File_reporter *fr = (File_reporter*) rep->data;
+    Out *o = &fr->out;
+    int i;
+
+    fr->sum = *sum;
+
+    for (i = 0; sum->cancelled > 0 && i < sum->tests + sum->cancelled; i++)
+    {
+        if (!sum->results[i].cancelled)
+            continue;
+
+        out_puts(o, "    <testcase classname=\"");
+        out_xml(o, s->name);
+        out_puts(o, "\" name=\"");
+        out_xml(o, sum->tcs[i]->name);
+        out_puts(o, "\">\n      <skipped message=\"cancelled (fail fast)\"/>"
+                "\n    </testcase>\n");
+    }
+}
+
+/*
+ * JUnit reporter: write the element of a benchmark inside the one of its
+ * suite, with its statistics as output.
+ */
+static void junit_bench(
+        Reporter *rep,
+        const Suite *s,
+        const Benchmark *bm,
+        const Bench_stats *bs)
+{
+    File_reporter *fr = (File_reporter*) rep->data;
+    Out *o = &fr->out;
+    char msg[MSG_LEN];
+
+    fr->sum.tests++;
+
+    out_puts(o, "    <testcase classname=\"");
+    out_xml(o, s->name);
+    out_puts(o, "\" name=\"");
+    out_xml(o, bm->name);
+
+    if (describe_bench_error(bs, msg, sizeof (msg)))
+    {
+        fr->sum.errors++;
+        out_puts(o, "\">\n      <error message=\"");
+        out_xml(o, msg);
+        out_puts(o, "\"/>\n    </testcase>\n");
+        return;
+    }
+
+    out_printf(o, "\" time=\"%.6f\">\n      <system-out>%d samples of %zu"
+            " iterations, mean %.3f ns/op, median %.3f ns/op, stddev %.3f"
+            " ns/op, min %.3f ns/op</system-out>\n    </testcase>\n",
+            bs->mean * bs->iterations * bs->samples / 1e9,
+            bs->samples,
+            bs->iterations,
+            bs->mean,
+            bs->median,
+            bs->stddev,
+            bs->min);
+}
+
+/*
+ * JUnit reporter: close the document.
+ */
+static void junit_close(Reporter *rep)
+{
+    File_reporter *fr = (File_reporter*) rep->data;
+
+    junit_write_suite(fr);
+    if (fr->suites == 0)
+        out_puts(&fr->out, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                "<testsuites>\n");
+    out_puts(&fr->out, "</testsuites>\n");
+    out_flush(&fr->out);
+}
+
+/*!
+ * Create a reporter writing a JUnit XML document to a file descriptor.
+ */
+Reporter* reporter_junit(int fd)
+{
+    File_reporter *fr = file_reporter_new(fd);
+
+    fr->rep.start_suite = junit_start;
+    fr->rep.test_result = junit_result;
+    fr->rep.end_suite = junit_end;
+    fr->rep.close = junit_close;
+    fr->rep.bench_result = junit_bench;
+
+    return &fr->rep;
+}
+
+/*
+ * JSON Lines reporter: write the record of the start of a suite.
+ */
+static void jsonl_start(Reporter *rep, const Suite *s, int tests)
+{
+    File_reporter *fr = (File_reporter*) rep->data;
+
+    out_puts(&fr->out, "{\"event\":\"suite_start\",\"suite\":");
+    out_json(&fr->out, s->name);
+    out_printf(&fr->out, ",\"tests\":%d}\n", tests);
+}
+
+/*
+ * JSON Lines reporter: write the record of a test case.
+ */
+static void jsonl_result(
+        Reporter *rep,
+        const Suite *s,
+        const Test_case *tc,
+        const Result *res)
+{
+    static const char *outcomes[] = {"success", "failure", "error"};
+    File_reporter *fr = (File_reporter*) rep->data;
+    Out *o = &fr->out;
+    char msg[MSG_LEN];
+    int i;
+
+    out_puts(o, "{\"event\":\"test\",\"suite\":");
+    out_json(o, s->name);
+    out_puts(o, ",\"test\":");
+    out_json(o, tc->name);
+    out_printf(o, ",\"outcome\":\"%s\"", outcomes[__result_outcome(res)]);
+
+    if (describe_error(res, 0, msg, sizeof (msg)))
+    {
+        out_puts(o, ",\"message\":");
+        out_json(o, msg);
+    }
+    else if (res->failed || res->invalid)
+    {
+        out_puts(o, ",\"assertion\":");
+        out_json(o, res->assertion);
+        out_puts(o, ",\"file\":");
+        out_json(o, res->file);
+        out_printf(o, ",\"line\":%d", res->line);
+        if (res->message != NULL)
+        {
+            out_puts(o, ",\"message\":");
+            out_json(o, res->message);
+        }
+    }
+
+    if (describe_error(res, 1, msg, sizeof (msg)))
+    {
+        out_puts(o, ",\"cleanup_error\":");
+        out_json(o, msg);
+    }
+
+    if (__track_alloc())
+        out_printf(o, ",\"allocs\":%ld,\"frees\":%ld,\"alloc_bytes\":%ld,"
+                "\"leaked_blocks\":%ld,\"leaked_bytes\":%ld",
+                res->alloc.allocs,
+                res->alloc.frees,
+                res->alloc.bytes,
+                res->alloc.blocks,
+                res->alloc.leaked);
+
+    for (i = 0; i < PERF_COUNTERS; i++)
+        if (res->perf.mask & (1 << i))
+            out_printf(o, ",\"%s\":%ld", perf_names[i], res->perf.value[i]);
+
+    out_printf(o, ",\"wall_us\":%ld,\"user_us\":%ld,\"sys_us\":%ld,"
+            "\"max_rss\":%ld}\n",
+            res->m.wall_us,
+            res->m.user_us,
+            res->m.sys_us,
+            res->m.max_rss);
+    out_stream(o);
+}
+
+/*
+ * JSON Lines reporter: write the record of the end of a suite.
+ */
+static void jsonl_end(Reporter *rep, const Suite *s, const Summary *sum)
+{
+    File_reporter *fr = (File_reporter*) rep->data;
+
+    out_puts(&fr->out, "{\"event\":\"suite_end\",\"suite\":");
+    out_json(&fr->out, s->name);
+    out_printf(&fr->out, ",\"tests\":%d,\"successes\":%d,\"failures\":%d,"
+            "\"errors\":%d,\"skipped\":%d,\"cancelled\":%d,"
+            "\"after_all_sig\":%d,\"after_all_status\":%d,"
+            "\"wall_us\":%ld}\n",
+            sum->tests,
+            sum->successes,
+            sum->failures,
+            sum->errors,
+            sum->skipped,
+            sum->cancelled,
+            sum->after_all_sig,
+            sum->after_all_status,
+            sum->wall_us);
+    out_flush(&fr->out);
+}
+
+/*
+ * JSON Lines reporter: write the record of a benchmark, with its hardware
+ * counters averaged per iteration.
+ */
+static void jsonl_bench(
+        Reporter *rep,
+        const Suite *s,
+        const Benchmark *bm,
+        const Bench_stats *bs)
+{
+    File_reporter *fr = (File_reporter*) rep->data;
+    Out *o = &fr->out;
+    char msg[MSG_LEN];
+    int i;
+
+    out_puts(o, "{\"event\":\"benchmark\",\"suite\":");
+    out_json(o, s->name);
+    out_puts(o, ",\"benchmark\":");
+    out_json(o, bm->name);
+
+    if (describe_bench_error(bs, msg, sizeof (msg)))
+    {
+        out_puts(o, ",\"outcome\":\"error\",\"message\":");
+        out_json(o, msg);
+        out_puts(o, "}\n");
+        out_flush(o);
+        return;
+    }
+
+    out_printf(o, ",\"outcome\":\"success\",\"samples\":%d,"
+            "\"iterations\":%zu,\"mean_ns\":%.3f,\"median_ns\":%.3f,"
+            "\"stddev_ns\":%.3f,\"min_ns\":%.3f",
+            bs->samples,
+            bs->iterations,
+            bs->mean,
+            bs->median,
+            bs->stddev,
+            bs->min);
+
+    for (i = 0; i < PERF_COUNTERS; i++)
+        if (bs->perf_mask & (1 << i))
+            out_printf(o, ",\"%s_per_op\":%.3f,\"%s_per_op_min\":%.3f",
+                    perf_names[i], bs->perf_median[i],
+                    perf_names[i], bs->perf_min[i]);
+
+    out_puts(o, "}\n");
+    out_flush(o);
+}
+
+/*!
+ * Create a reporter writing JSON Lines records to a file descriptor.
+ */
+Reporter* reporter_jsonl(int fd)
+{
+    File_reporter *fr = file_reporter_new(fd);
+
+    fr->rep.start_suite = jsonl_start;
+    fr->rep.test_result = jsonl_result;
+    fr->rep.end_suite = jsonl_end;
+    fr->rep.bench_result = jsonl_bench;
+
+    return &fr->rep;
+}
+
+/*
+ * Append a name to a TAP line. '#' would start a directive in a test
+ * point, and a line break would end the line.
+ */
+static void tap_name(Out *o, const char *str)
+{
+    for (; *str != '\0'; str++)
+        out_putc(o, *str == '#' || *str == '\n' ? '_' : *str);
+}
+
+/*
+ * TAP reporter: write the version line and a comment for the suite.
+ */
+static void tap_start(Reporter *rep, const Suite *s, int tests)
+{
+    File_reporter *fr = (File_reporter*) rep->data;
+
+    (void) tests;
+
+    if (fr->suites++ == 0)
+        out_puts(&fr->out, "TAP version 13\n");
+
+    out_puts(&fr->out, "# Suite ");
+    tap_name(&fr->out, s->name);
+    out_putc(&fr->out, '\n');
+}
+
+/*
+ * Append a string to a TAP YAML block, as a quoted scalar.
+ */
+static void tap_yaml(Out *o, const char *key, const char *value)
+{
+    out_printf(o, "  %s: ", key);
+    out_json(o, value); /* JSON strings are valid YAML scalars */
+    out_putc(o, '\n');
+}
+
+/*
+ * TAP reporter: write the test point of a test case, with a YAML block
+ * describing failures and errors.
+ */
+static void tap_result(
+        Reporter *rep,
+        const Suite *s,
+        const Test_case *tc,
+        const Result *res)
+{
+    File_reporter *fr = (File_reporter*) rep->data;
+    Out *o = &fr->out;
+    char msg[MSG_LEN];
+    char at[FILE_LEN + 16];
+    int ok = __result_outcome(res) == OUTCOME_SUCCESS;
+    int cleanup = describe_error(res, 1, msg, sizeof (msg));
+
+    out_printf(o, "%sok %d - ", ok ? "" : "not ", ++fr->count);
+    tap_name(o, s->name);
+    out_puts(o, ": ");
+    tap_name(o, tc->name);
+    out_putc(o, '\n');
+
+    if (ok && !cleanup)
+    {
+        out_stream(o);
+        return;
+    }
+
+    out_puts(o, "  ---\n");
+    if (cleanup)
+        tap_yaml(o, "cleanup", msg);
+    if (describe_error(res, 0, msg, sizeof (msg)))
+    {
+        tap_yaml(o, "severity", "error");
+        tap_yaml(o, "message", msg);
+    }
+    else if (res->failed || res->invalid)
+    {
+        tap_yaml(o, "severity", res->invalid ? "error" : "fail");
+        tap_yaml(o, "message", 
+                res->message != NULL ? res->message : res->assertion);
+        tap_yaml(o, "assertion", res->assertion);
+        snprintf(at, sizeof (at), "%s:%d", res->file, res->line);
+        tap_yaml(o, "at", at);
+    }
+    out_puts(o, "  ...\n");
+    out_stream(o);
+}
+
+/*
+ * TAP reporter: write the test point of a benchmark, with a YAML block 
+ * holding its statistics or its error.
+ */
+static void tap_bench(
+        Reporter *rep,
+        const Suite *s,
+        const Benchmark *bm,
+        const Bench_stats *bs)
+{
+    File_reporter *fr = (File_reporter*) rep->data;
+    Out *o = &fr->out;
+    char msg[MSG_LEN];
+    int failed = describe_bench_error(bs, msg, sizeof (msg));
+
+    out_printf(o, "%sok %d - ", failed ? "not " : "", ++fr->count);
+    tap_name(o, s->name);
+    out_puts(o, ": ");
+    tap_name(o, bm->name);
+    out_puts(o, "\n  ---\n");
+
+    if (failed)
+    {
+        tap_yaml(o, "severity", "error");
+        tap_yaml(o, "message", msg);
+    }
+    else
+        out_printf(o, "  samples: %d\n  iterations: %zu\n"
+                "  mean_ns: %.3f\n  median_ns: %.3f\n  stddev_ns: %.3f\n"
+                "  min_ns: %.3f\n",
+                bs->samples,
+                bs->iterations,
+                bs->mean,
+                bs->median,
+                bs->stddev,
+                bs->min);
+
+    out_puts(o, "  ...\n");
+    out_flush(o);
+}
+
+/*
+ * TAP reporter: write the buffered test points.
+ */
+static void tap_end(Reporter *rep, const Suite *s, const Summary *sum)
+{
+    (void) s;
+    (void) sum;
+
+    out_flush(&((File_reporter*) rep->data)->out);
+}
+
+/*
+ * TAP reporter: write the plan, once the number of test cases is known.
+ */
+static void tap_close(Reporter *rep)
+{
+    File_reporter *fr = (File_reporter*) rep->data;
+
+    if (fr->suites == 0)
+        out_puts(&fr->out, "TAP version 13\n");
+    out_printf(&fr->out, "1..%d\n", fr->count);
+    out_flush(&fr->out);
+}
+
+/*!
+ * Create a reporter writing a TAP version 13 stream to a file descriptor.
+ */
+Reporter* reporter_tap(int fd)
+{
+    File_reporter *fr = file_reporter_new(fd);
+
+    fr->rep.start_suite = tap_start;
+    fr->rep.test_result = tap_result;
+    fr->rep.end_suite = tap_end;
+    fr->rep.close = tap_close;
+    fr->rep.bench_result = tap_bench;
+
+    return &fr->rep;
+}
+
+/*!
+ * Add a reporter, receiving the events of the following suite runs.
+ */
+int cutest_add_reporter(Reporter *rep)
+{
+    if (reporters_num == REPORTER_MAX)
+    {
+        fprintf(stderr, "cutest_add_reporter: too many reporters.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    reporters[reporters_num++] = rep;
+    return 0;
+}
+
+/*
+ * Close the reporters at the program exit. Children of the runner
+ * inherit this handler, but the reporters belong to their parent.
+ */
+static void close_reporters(void)
+{
+    int i;
+
+    if (getpid() != reporters_pid)
+        return;
+
+    for (i = 0; i < reporters_num; i++)
+        if (reporters[i]->close != NULL)
+            reporters[i]->close(reporters[i]);
+}
+
+/*
+ * Create the reporters listed in the CUTEST_REPORTER environment variable,
+ * a comma separated list of items in the form <kind>[:<path>], where kind
+ * is one of console, junit, jsonl or tap, and path is the output file,
+ * standard output if omitted or "-". When the variable is not set, the
+ * console reporter is used.
+ */
+static void init_reporters(void)
+{
+    const char *env = getenv("CUTEST_REPORTER");
+    char *list;
+    char *item;
+    char *path;
+    char *save;
+    int fd;
+
+    reporters_init = 1;
+    reporters_pid = getpid();
+    atexit(close_reporters);
+
+    if (env == NULL || *env == '\0')
+    {
+        cutest_add_reporter(&console_reporter);
+        return;
+    }
+
+    list = strdup(env);
+    if (list == NULL)
+    {
+        perror("reporter: malloc error.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (item = strtok_r(list, ",", &save); item != NULL;
+            item = strtok_r(NULL, ",", &save))
+    {
+        path = strchr(item, ':');
+        if (path != NULL)
+            *path++ = '\0';
+
+        fd = STDOUT_FILENO;
+        if (path != NULL && *path != '\0' && strcmp(path, "-"))
+        {
+            fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd == -1)
+            {
+                perror("reporter: open error.\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        if (!strcmp(item, "console"))
+            cutest_add_reporter(&console_reporter);
+        else if (!strcmp(item, "junit"))
+            cutest_add_reporter(reporter_junit(fd));
+        else if (!strcmp(item, "jsonl"))
+            cutest_add_reporter(reporter_jsonl(fd));
+        else if (!strcmp(item, "tap"))
+            cutest_add_reporter(reporter_tap(fd));
+        else
+        {
+            fprintf(stderr, "CUTEST_REPORTER: unknown reporter \"%s\".\n",
+                    item);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    free(list);
+}
+
+/*!
+ * Notify the reporters of the start of a suite run.
+ */
+int __report_start(const Suite *s, int tests)
+{
+    int i;
+
+    if (!reporters_init)
+        init_reporters();
+
+    for (i = 0; i < reporters_num; i++)
+        reporters[i]->start_suite(reporters[i], s, tests);
+
+    return 0;
+}
+
+/*!
+ * Notify the reporters of the outcome of a test case.
+ */
+int __report_result(const Suite *s, const Test_case *tc, const Result *res)
+{
+    int i;
+
+    for (i = 0; i < reporters_num; i++)
+        reporters[i]->test_result(reporters[i], s, tc, res);
+
+    return 0;
+}
+
+/*!
+ * Notify the reporters of the end of a suite run.
+ */
+int __report_end(const Suite *s, const Summary *sum)
+{
+    int i;
+
+    for (i = 0; i < reporters_num; i++)
+        reporters[i]->end_suite(reporters[i], s, sum);
+
+    return 0;
+}
+
+/*!
+ * Notify the reporters of the outcome of a benchmark.
+ */
+int __report_bench(const Suite *s, const Benchmark *bm, const Bench_stats *bs)
+{
+    int i;
+
+    for (i = 0; i < reporters_num; i++)
+        if (reporters[i]->bench_result != NULL)
+            reporters[i]->bench_result(reporters[i], s, bm, bs);
+
+    return 0;
+}
@@ -0,0 +1,290 @@
+/*
+ * This file is part of cUTest.
+ *
+ * cUTest is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cUTest is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cUTest. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Martino Pilia, 2015
+ */
+
+/*!
+ * \file snapshot.c
+ *
+ * @author Martino Pilia
+ * @date 2015-01-13
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "cutest.h"
+
+/*
+ * Number of bytes shown around the first difference, and number of them
+ * preceding it.
+ */
+#define HEX_WINDOW 16
+#define HEX_BEFORE 8
+
+/*
+ * A file mapped in memory. Empty files are not mapped.
+ */
+typedef struct mapping
+{
+    const unsigned char *data; /* content of the file */
+    size_t len;                /* size of the file */
+} Mapping;
+
+/*
+ * Map a file read only, returning nonzero on success. On failure, errno
+ * describes the error.
+ */
+static int map_file(const char *path, Mapping *m)
+{
+    struct stat st;
+    void *p;
+    int fd;
+
+    m->data = NULL;
+    m->len = 0;
+
+    fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return 0;
+
+    if (fstat(fd, &st) == -1)
+    {
+        close(fd);
+        return 0;
+    }
+
+    if (st.st_size > 0)
+    {
+        p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED)
+        {
+            close(fd);
+            return 0;
+        }
+        m->data = (const unsigned char*) p;
+        m->len = st.st_size;
+    }
+
+    close(fd);
+    return 1;
+}
+
+/*
+ * Release a mapped file.
+ */
+static void unmap_file(Mapping *m)
+{
+    if (m->data != NULL)
+        munmap((void*) m->data, m->len);
+}
+
+/*
+ * Check if the snapshot files must be rewritten instead of compared, as
+ * requested with the CUTEST_UPDATE_SNAPSHOTS environment variable.
+ */
+static int update_snapshots(void)
+{
+    const char *env = getenv("CUTEST_UPDATE_SNAPSHOTS");
+
+    return env != NULL && env[0] != '\0' && strcmp(env, "0") != 0;
+}
+
+/*
+ * Replace the content of a file atomically, writing a temporary file in
+ * the same directory and renaming it. Return nonzero on success.
+ */
+static int write_file(const char *path, const void *buf, size_t len)
+{
+    char tmp[PATH_MAX];
+    const char *p = (const char*) buf;
+    ssize_t n;
+    int fd;
+
+    snprintf(tmp, sizeof (tmp), "%s.tmp.%d", path, (int) getpid());
+
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1)
+        return 0;
+
+    while (len > 0)
+    {
+        n = write(fd, p, len);
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n == -1)
+        {
+            close(fd);
+            unlink(tmp);
+            return 0;
+        }
+        p += n;
+        len -= n;
+    }
+
+    if (fsync(fd) == -1 || close(fd) == -1 || rename(tmp, path) == -1)
+    {
+        unlink(tmp);
+        return 0;
+    }
+
+    return 1;
+}
+
+/*
+ * Write at most HEX_WINDOW bytes of a buffer in hexadecimal, from the
+ * given offset, enclosing in brackets the byte at the position of the
+ * difference. Missing bytes, past the end of the buffer, are shown as
+ * "--".
+ */
+static int hex_window(
+        char *out,
+        size_t size,
+        const unsigned char *data,
+        size_t len,
+        size_t from,
+        size_t diff)
+{
+    size_t i;
+    int n = 0;
+
+    for (i = from; i < from + HEX_WINDOW && n < (int) size; ++i)
+    {
+        if (i < len)
+            n += snprintf(out + n, size - n, i == diff ? "[%02x] " : "%02x ",
+                    data[i]);
+        else
+            n += snprintf(out + n, size - n, i == diff ? "[--] " : "-- ");
+    }
+
+    return n;
+}
+
+/*
+ * Compare a buffer with a reference, writing in the status message the
+ * offset of the first difference, with the bytes around it.
+ */
+static void compare_snapshot(
+        const unsigned char *x,
+        size_t x_len,
+        const unsigned char *y,
+        size_t y_len,
+        Status *__s)
+{
+    char actual[6 * HEX_WINDOW];
+    char expected[6 * HEX_WINDOW];
+    size_t len = x_len < y_len ? x_len : y_len;
+    size_t off;
+    size_t from;
+
+    off = len > 0 ? __compare_bytes(x, y, len) : 0;
+
+    __s->failed = off < len || x_len != y_len;
+    __s->invalid = 0;
+    if (!__s->failed)
+        return;
+
+    from = off > HEX_BEFORE ? off - HEX_BEFORE : 0;
+    hex_window(actual, sizeof (actual), x, x_len, from, off);
+    hex_window(expected, sizeof (expected), y, y_len, from, off);
+
+    snprintf(__s->message, MSG_LEN,
+            "First difference at offset %zu (sizes %zu and %zu), "
+            "bytes from offset %zu:\n"
+            "  actual:   %s\n"
+            "  expected: %s",
+            off, x_len, y_len, from, actual, expected);
+}
+
+/*!
+ * This function actually implements the comparison of a buffer with the
+ * content of a file. In update mode, the file is rewritten when it is
+ * missing or different.
+ */
+int __assert_equals_file(const void *buf, size_t len, const char *path,
+        Status *__s)
+{
+    Mapping ref;
+
+    if (!map_file(path, &ref))
+    {
+        if (update_snapshots() && write_file(path, buf, len))
+        {
+            __s->failed = 0;
+            __s->invalid = 0;
+            return 0;
+        }
+
+        snprintf(__s->message, MSG_LEN,
+                "Cannot read reference file \"%s\" (%s). Run with "
+                "CUTEST_UPDATE_SNAPSHOTS=1 to create it.",
+                path, strerror(errno));
+        __s->failed = 1;
+        __s->invalid = 1;
+        return 0;
+    }
+
+    compare_snapshot(buf, len, ref.data, ref.len, __s);
+    unmap_file(&ref);
+
+    if (__s->failed && update_snapshots())
+    {
+        if (write_file(path, buf, len))
+        {
+            __s->failed = 0;
+            return 0;
+        }
+
+        snprintf(__s->message, MSG_LEN,
+                "Cannot update reference file \"%s\" (%s).",
+                path, strerror(errno));
+        __s->invalid = 1;
+    }
+
+    return 0;
+}
+
+/*!
+ * This function actually implements the comparison of two files. The
+ * second is the reference, rewritten with the content of the first in
+ * update mode.
+ */
+int __assert_files_equal(const char *path, const char *ref_path,
+        Status *__s)
+{
+    Mapping m;
+
+    if (!map_file(path, &m))
+    {
+        snprintf(__s->message, MSG_LEN, "Cannot read file \"%s\" (%s).",
+                path, strerror(errno));
+        __s->failed = 1;
+        __s->invalid = 1;
+        return 0;
+    }
+
+    __assert_equals_file(m.data, m.len, ref_path, __s);
+    unmap_file(&m);
+
+    return 0;
+}
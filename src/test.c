@@ -0,0 +1,640 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) Martino Pilia, 2015
+ */
+
+/*!
+ * \file test.c
+ * \brief Tests of the library, run by <tt>make test</tt>
+ *
+ * The comparison kernels are checked against plain loops, so running the
+ * program with <tt>CUTEST_SIMD=none</tt> too covers both the vectorized
+ * and the scalar paths.
+ *
+ * @author Martino Pilia
+ * @date 2015-01-13
+ */
+
+#define CUTEST_AUTO_REGISTER
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "cutest.h"
+
+/*
+ * Longest array compared by the kernel tests, covering several vectors
+ * and all the tail lengths of the widest kernel.
+ */
+#define MAX_LEN 70
+
+/*
+ * Largest misalignment, in entries, of the arrays compared by the kernel
+ * tests.
+ */
+#define MAX_OFF 4
+
+/*
+ * Side of the square matrix large enough to be compared by threads.
+ */
+#define BIG_SIDE 2048
+
+/*
+ * Number of test cases of the suite used by the selection tests.
+ */
+#define SEL_TESTS 23
+
+static int ints_x[MAX_LEN + MAX_OFF];
+static int ints_y[MAX_LEN + MAX_OFF];
+static double dbls_x[MAX_LEN + MAX_OFF];
+static double dbls_y[MAX_LEN + MAX_OFF];
+static float flts_x[MAX_LEN + MAX_OFF];
+static float flts_y[MAX_LEN + MAX_OFF];
+
+/*
+ * Fill the arrays with the same values.
+ */
+static void fill(void)
+{
+    int i;
+
+    for (i = 0; i < MAX_LEN + MAX_OFF; i++)
+    {
+        ints_x[i] = ints_y[i] = 3 * i - 50;
+        dbls_x[i] = dbls_y[i] = 0.25 * i - 3.0;
+        flts_x[i] = flts_y[i] = 0.5f * i - 7.0f;
+    }
+}
+
+TEST_CASE(kernel_int)
+{
+    size_t len;
+    size_t pos;
+    int a;
+    int b;
+
+    fill();
+    for (a = 0; a < MAX_OFF; a++)
+        for (b = 0; b < MAX_OFF; b++)
+        {
+            memmove(ints_y + b, ints_x + a, MAX_LEN * sizeof (int));
+
+            for (len = 0; len <= MAX_LEN; len++)
+                for (pos = 0; pos <= len; pos++)
+                {
+                    if (pos < len)
+                        ints_y[b + pos] ^= 1 << (pos % 31);
+
+                    assert_equals_int(
+                            (long) __compare_int(ints_x + a, ints_y + b,
+                                len),
+                            (long) pos,
+                            "First mismatch of int arrays");
+                    assert_equals_int(
+                            (long) (__compare_bytes(ints_x + a, ints_y + b,
+                                    len * sizeof (int)) / sizeof (int)),
+                            (long) pos,
+                            "First mismatch of bytes");
+
+                    if (pos < len)
+                        ints_y[b + pos] ^= 1 << (pos % 31);
+                }
+        }
+}
+
+TEST_CASE(kernel_double)
+{
+    size_t len;
+    size_t pos;
+    int a;
+    int b;
+
+    fill();
+    for (a = 0; a < MAX_OFF; a++)
+        for (b = 0; b < MAX_OFF; b++)
+        {
+            memmove(dbls_y + b, dbls_x + a, MAX_LEN * sizeof (double));
+
+            for (len = 0; len <= MAX_LEN; len++)
+                for (pos = 0; pos <= len; pos++)
+                {
+                    if (pos < len)
+                        dbls_y[b + pos] += 1.0;
+
+                    assert_equals_int(
+                            (long) __compare_equal_dbl(dbls_x + a,
+                                dbls_y + b, len),
+                            (long) pos,
+                            "First mismatch of double arrays");
+                    assert_equals_int(
+                            (long) __compare_flo(dbls_x + a, dbls_y + b,
+                                len, 0.5),
+                            (long) pos,
+                            "First mismatch with tolerance");
+                    assert_equals_int(
+                            (long) __compare_flo(dbls_x + a, dbls_y + b,
+                                len, 2.0),
+                            (long) len,
+                            "Difference within tolerance");
+
+                    if (pos < len)
+                        dbls_y[b + pos] -= 1.0;
+                }
+        }
+}
+
+TEST_CASE(kernel_float)
+{
+    size_t len;
+    size_t pos;
+    int a;
+    int b;
+
+    fill();
+    for (a = 0; a < MAX_OFF; a++)
+        for (b = 0; b < MAX_OFF; b++)
+        {
+            memmove(flts_y + b, flts_x + a, MAX_LEN * sizeof (float));
+
+            for (len = 0; len <= MAX_LEN; len++)
+                for (pos = 0; pos <= len; pos++)
+                {
+                    if (pos < len)
+                        flts_y[b + pos] += 1.0f;
+
+                    assert_equals_int(
+                            (long) __compare_equal_flt(flts_x + a,
+                                flts_y + b, len),
+                            (long) pos,
+                            "First mismatch of float arrays");
+
+                    if (pos < len)
+                        flts_y[b + pos] -= 1.0f;
+                }
+        }
+}
+
+TEST_CASE(kernel_signed_zero)
+{
+    double x[MAX_LEN];
+    double y[MAX_LEN];
+    size_t i;
+
+    for (i = 0; i < MAX_LEN; i++)
+    {
+        x[i] = 0.0;
+        y[i] = -0.0;
+    }
+    assert_equals_int((long) __compare_equal_dbl(x, y, MAX_LEN), MAX_LEN,
+            "Zeros of different sign are equal");
+}
+
+TEST_CASE(kernel_ulp)
+{
+    double x[MAX_LEN];
+    double y[MAX_LEN];
+    Mismatch mm;
+    size_t len;
+    size_t pos;
+    size_t i;
+
+    for (i = 0; i < MAX_LEN; i++)
+        x[i] = y[i] = 1.0 + i;
+
+    for (len = 1; len <= MAX_LEN; len++)
+        for (pos = 0; pos < len; pos++)
+        {
+            y[pos] = nextafter(nextafter(x[pos], 1e300), 1e300);
+
+            assert_equals_int((long) __compare_ulp_dbl(x, y, len, 1, &mm), 1,
+                    "Entries out of tolerance");
+            assert_equals_int((long) mm.worst, (long) pos, "Worst entry");
+            assert_equals_int((long) __compare_ulp_dbl(x, y, len, 2, &mm), 0,
+                    "Entries within tolerance");
+
+            y[pos] = x[pos];
+        }
+}
+
+TEST_CASE(kernel_ulp_nan)
+{
+    double x[MAX_LEN];
+    double y[MAX_LEN];
+    float xf[MAX_LEN];
+    float yf[MAX_LEN];
+    Mismatch mm;
+    size_t len;
+    size_t pos;
+    size_t i;
+
+    for (i = 0; i < MAX_LEN; i++)
+    {
+        x[i] = y[i] = 1.0 + i;
+        xf[i] = yf[i] = 1.0f + i;
+    }
+
+    for (len = 1; len <= MAX_LEN; len++)
+        for (pos = 0; pos < len; pos++)
+        {
+            y[pos] = NAN;
+            yf[pos] = NAN;
+
+            assert_equals_int(
+                    (long) __compare_ulp_dbl(x, y, len, UINT64_MAX, &mm), 1,
+                    "NaN out of any double tolerance");
+            assert_equals_int((long) mm.worst, (long) pos, "Double NaN");
+            assert_equals_int(
+                    (long) __compare_ulp_flt(xf, yf, len, UINT64_MAX, &mm),
+                    1,
+                    "NaN out of any float tolerance");
+            assert_equals_int((long) mm.worst, (long) pos, "Float NaN");
+            assert_equals_int(
+                    (long) __compare_ulp_flt(yf, yf, len, UINT32_MAX, &mm),
+                    1,
+                    "NaN different from itself");
+
+            y[pos] = x[pos];
+            yf[pos] = xf[pos];
+        }
+}
+
+/*
+ * Compare a matrix with a copy stored in the given order, with one or two
+ * different entries, and check the reported position.
+ */
+static void check_strided(
+        int *x,
+        int *y,
+        size_t m,
+        size_t n,
+        int x_cols,
+        int y_cols,
+        Status *st)
+{
+    ptrdiff_t strides[4];
+
+    strides[0] = x_cols ? 1 : (ptrdiff_t) n;
+    strides[1] = x_cols ? (ptrdiff_t) m : 1;
+    strides[2] = y_cols ? 1 : (ptrdiff_t) n;
+    strides[3] = y_cols ? (ptrdiff_t) m : 1;
+
+    memset(st, 0, sizeof (Status));
+    __assert_equals_strided(x, y, m, n, strides, TYPE_INT, TYPE_INT, st);
+}
+
+/*
+ * Fill a matrix, stored by rows or by columns, with a function of the
+ * position of each entry.
+ */
+static void fill_matrix(int *x, size_t m, size_t n, int cols)
+{
+    size_t i;
+    size_t j;
+
+    for (i = 0; i < m; i++)
+        for (j = 0; j < n; j++)
+            x[cols ? j * m + i : i * n + j] = (int) (i * 1000 + j);
+}
+
+TEST_CASE(strided_order)
+{
+    int x[5 * 7];
+    int y[5 * 7];
+    Status st;
+    int xc;
+    int yc;
+
+    for (xc = 0; xc < 2; xc++)
+        for (yc = 0; yc < 2; yc++)
+        {
+            fill_matrix(x, 5, 7, xc);
+            fill_matrix(y, 5, 7, yc);
+
+            check_strided(x, y, 5, 7, xc, yc, &st);
+            assert_false(st.failed, "Equal matrixes");
+
+            /* [2][0] is later in row major order, earlier by columns */
+            y[yc ? 0 * 5 + 2 : 2 * 7 + 0] = -1;
+            y[yc ? 3 * 5 + 1 : 1 * 7 + 3] = -1;
+
+            check_strided(x, y, 5, 7, xc, yc, &st);
+            assert(st.failed && !st.invalid, "Different matrixes");
+            assert_equals_str(st.message,
+                    "First mismatch at [1][3]: 1003 != -1.",
+                    "First mismatch in row major order");
+        }
+}
+
+TEST_CASE(strided_threads)
+{
+    int *x = (int*) malloc(BIG_SIDE * BIG_SIDE * sizeof (int));
+    int *y = (int*) malloc(BIG_SIDE * BIG_SIDE * sizeof (int));
+    Status st;
+    int yc;
+
+    assert(x != NULL && y != NULL, "Allocation of the matrixes");
+
+    for (yc = 0; yc < 2; yc++)
+    {
+        fill_matrix(x, BIG_SIDE, BIG_SIDE, 0);
+        fill_matrix(y, BIG_SIDE, BIG_SIDE, yc);
+        y[yc ? 7 * BIG_SIDE + 1500 : 1500 * BIG_SIDE + 7] = -1;
+        y[yc ? 2000 * BIG_SIDE + 1000 : 1000 * BIG_SIDE + 2000] = -1;
+
+        check_strided(x, y, BIG_SIDE, BIG_SIDE, 0, yc, &st);
+        assert_equals_str(st.message,
+                "First mismatch at [1000][2000]: 1002000 != -1.",
+                "First mismatch found by the threads");
+    }
+
+    free(x);
+    free(y);
+}
+
+TEST_CASE(array_first_mismatch)
+{
+    long x[9] = {1, 2, 3, 4, 5, 6, 7, 8, 9};
+    long y[9] = {1, 2, 3, 4, 0, 6, 0, 8, 9};
+    Status st;
+
+    memset(&st, 0, sizeof (Status));
+    __assert_equals_typed(x, y, 9, 1, SHAPE_ARRAY, TYPE_LONG, TYPE_LONG,
+            &st);
+    assert(st.failed && !st.invalid, "Different arrays");
+    assert_equals_str(st.message, "First mismatch at index 4: 5 != 0.",
+            "Position of the mismatch");
+}
+
+/*
+ * Run a function with assertions as the runner runs a test case.
+ */
+static void run_status(void (*fun)(Status*), Status *st)
+{
+    memset(st, 0, sizeof (Status));
+    __alloc_thread_reset();
+    fun(st);
+    __alloc_regions_check(st);
+}
+
+static void region_break(Status *__s)
+{
+    int i;
+
+    for (i = 0; i < 3; i++)
+        ASSERT_NO_ALLOC("Loop body")
+        {
+            if (i == 1)
+                break;
+        }
+    assert(i == 3, "Break applied to the region");
+}
+
+static void region_return(Status *__s)
+{
+    ASSERT_NO_ALLOC("Early return")
+    {
+        return;
+    }
+}
+
+static void region_failure(Status *__s)
+{
+    ASSERT_NO_ALLOC("Failure inside")
+    {
+        assert(0, "Inner failure");
+    }
+}
+
+static void region_malloc(Status *__s)
+{
+    void *p = NULL;
+
+    ASSERT_NO_ALLOC("Allocation")
+    {
+        p = malloc(64);
+        do_not_optimize(p);
+    }
+    free(p);
+}
+
+static void region_continue(Status *__s)
+{
+    int n = 0;
+
+    ASSERT_NO_ALLOC("Continue")
+    {
+        n++;
+        continue;
+    }
+    assert_equals_int(n, 1, "Region executed once");
+}
+
+TEST_CASE(no_alloc_early_exit)
+{
+    Status st;
+
+    run_status(region_break, &st);
+    assert(st.failed && st.invalid, "Region left with break");
+    assert_equals_str(st.assertion, "ASSERT_NO_ALLOC(\"Loop body\")",
+            "Assertion of the region left with break");
+
+    run_status(region_return, &st);
+    assert(st.failed && st.invalid, "Region left with return");
+
+    run_status(region_failure, &st);
+    assert(st.failed && !st.invalid, "Failure inside the region");
+    assert_equals_str(st.assertion, "assert(0, \"Inner failure\")",
+            "Assertion failed inside the region");
+
+    run_status(region_malloc, &st);
+    assert(st.failed && !st.invalid, "Allocation inside the region");
+
+    run_status(region_continue, &st);
+    assert_false(st.failed, "Region left with continue");
+}
+
+TEST_CASE(max_rss_baseline)
+{
+    size_t len = 64 << 20;
+    char *p = (char*) mmap(NULL, len, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    assert(p != MAP_FAILED, "Mapping of the memory");
+    memset(p, 1, len);
+    munmap(p, len);
+
+    assert(__peak_rss_reset() == 0, "Reset of the peak");
+    assert_max_rss_below(32 << 20, "Peak measured since the reset");
+}
+
+/*
+ * Empty test case, added to the suite used by the selection tests.
+ */
+static void nop(Status *__s)
+{
+    (void) __s;
+}
+
+/*
+ * Build a suite with test cases named t0, t1, ...
+ */
+static Suite* selection_suite(void)
+{
+    char name[16];
+    Suite *s;
+    int i;
+
+    suite_new(&s, "sel", NULL, NULL);
+    for (i = 0; i < SEL_TESTS; i++)
+    {
+        snprintf(name, sizeof (name), "t%d", i);
+        suite_add(s, nop, name);
+    }
+    return s;
+}
+
+/*
+ * Select the test cases of the suite in a child process, which starts
+ * with no shard assigned yet, and mark the selected ones. Return the
+ * number of selected test cases.
+ */
+static int select_child(Suite *s, const char *shard, const char *by,
+        char *keep)
+{
+    Test_case *sel[SEL_TESTS];
+    int fd[2];
+    int n;
+    int i;
+    pid_t pid;
+
+    if (pipe(fd))
+        return -1;
+
+    pid = fork();
+    if (pid == 0)
+    {
+        close(fd[0]);
+        setenv("CUTEST_CACHE", "", 1);
+        setenv("CUTEST_SHARD", shard, 1);
+        setenv("CUTEST_SHARD_BY", by, 1);
+        memset(keep, 0, SEL_TESTS);
+        n = __suite_select(s, sel);
+        for (i = 0; i < n; i++)
+            keep[sel[i] - s->tests] = 1;
+        _exit(write(fd[1], keep, SEL_TESTS) != SEL_TESTS);
+    }
+
+    close(fd[1]);
+    n = pid > 0 && read(fd[0], keep, SEL_TESTS) == SEL_TESTS ? 0 : -1;
+    close(fd[0]);
+    waitpid(pid, NULL, 0);
+
+    for (i = 0; n >= 0 && i < SEL_TESTS; i++)
+        n += keep[i];
+    return n;
+}
+
+/*
+ * Check that the shards of the suite are a partition, and that their
+ * sizes differ at most by one.
+ */
+static int is_partition(const char *by, int count)
+{
+    Suite *s = selection_suite();
+    char keep[SEL_TESTS];
+    char seen[SEL_TESTS] = {0};
+    char shard[16];
+    int index;
+    int n;
+    int i;
+
+    unsetenv("CUTEST_FILTER");
+    for (index = 1; index <= count; index++)
+    {
+        snprintf(shard, sizeof (shard), "%d/%d", index, count);
+        n = select_child(s, shard, by, keep);
+        if (n < SEL_TESTS / count || n > SEL_TESTS / count + 1)
+            return 0;
+
+        for (i = 0; i < SEL_TESTS; i++)
+        {
+            if (keep[i] && seen[i])
+                return 0;
+            seen[i] |= keep[i];
+        }
+    }
+
+    for (i = 0; i < SEL_TESTS; i++)
+        if (!seen[i])
+            return 0;
+    return 1;
+}
+
+TEST_CASE(shard_index)
+{
+    assert(is_partition("index", 1), "Single shard");
+    assert(is_partition("index", 4), "Round robin shards");
+    assert(is_partition("index", SEL_TESTS), "One test case per shard");
+}
+
+TEST_CASE(shard_time)
+{
+    assert(is_partition("time", 3), "Shards balanced by time");
+    assert(is_partition("time", 5), "Shards balanced by time");
+}
+
+/*
+ * Count the test cases selected by a filter.
+ */
+static int count_filter(Suite *s, const char *filter, const char *test)
+{
+    Test_case *sel[SEL_TESTS];
+    int n;
+    int i;
+
+    setenv("CUTEST_FILTER", filter, 1);
+    n = __suite_select(s, sel);
+    for (i = 0; test != NULL && i < n; i++)
+        if (!strcmp(sel[i]->name, test))
+            return -n;
+    return n;
+}
+
+TEST_CASE(filter)
+{
+    Suite *s = selection_suite();
+
+    unsetenv("CUTEST_SHARD");
+    assert_equals_int(count_filter(s, "", NULL), SEL_TESTS, "No filter");
+    assert_equals_int(count_filter(s, "t1*", NULL), 11, "Glob pattern");
+    assert_equals_int(count_filter(s, "t1?", NULL), 10, "Single character");
+    assert_equals_int(count_filter(s, "sel/t2", "t2"), -1, "Suite prefix");
+    assert_equals_int(count_filter(s, "t3,t5", NULL), 2, "Pattern list");
+    assert_equals_int(count_filter(s, "!t1*", NULL), SEL_TESTS - 11,
+            "Negative pattern");
+    assert_equals_int(count_filter(s, "t*,!t2*", NULL), SEL_TESTS - 4,
+            "Negative pattern after a positive one");
+    assert_equals_int(count_filter(s, "other/t1", NULL), 0,
+            "Other suite");
+}
+
+int main()
+{
+    return cutest_run_all();
+}